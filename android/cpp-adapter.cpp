@@ -16,7 +16,26 @@ Java_com_jsiudp_JsiUdpModule_nativeInstall(JNIEnv *env, jclass _, jlong jsiPtr,
     }->cthis()->getCallInvoker()
   };
 
-  manager = std::make_shared<jsiudp::UdpManager>(runtime, std::move(jsCallInvoker));
+  manager = jsiudp::UdpManager::make(runtime, std::move(jsCallInvoker));
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_jsiudp_JsiUdpModule_nativeInstallRuntime(JNIEnv *env, jclass _, jlong jsiPtr, jobject callInvokerHolder) {
+  auto runtime { reinterpret_cast<facebook::jsi::Runtime*>(jsiPtr) };
+  auto callInvoker {
+    facebook::jni::alias_ref<facebook::react::CallInvokerHolder::javaobject>{
+      reinterpret_cast<facebook::react::CallInvokerHolder::javaobject>(callInvokerHolder)
+    }->cthis()->getCallInvoker()
+  };
+
+  return jsiudp::UdpManager::installRuntime(runtime, std::move(callInvoker));
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_jsiudp_JsiUdpModule_nativeUninstallRuntime(JNIEnv *env, jclass _, jlong jsiPtr) {
+  return jsiudp::UdpManager::uninstallRuntime(reinterpret_cast<facebook::jsi::Runtime*>(jsiPtr));
 }
 
 extern "C"
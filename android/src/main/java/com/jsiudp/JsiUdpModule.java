@@ -28,6 +28,21 @@ public class JsiUdpModule extends ReactContextBaseJavaModule {
 
   private static native void nativeReset();
 
+  private static native boolean nativeInstallRuntime(long jsiPtr, CallInvokerHolderImpl callInvokerHolder);
+
+  private static native boolean nativeUninstallRuntime(long jsiPtr);
+
+  // Exposes the datagram_* API on a secondary runtime (e.g. a worklet runtime), on that
+  // runtime's thread, once the main runtime has installed the module. Call uninstallRuntime
+  // before the runtime is torn down; that closes its sockets.
+  public static boolean installRuntime(long jsiPtr, CallInvokerHolderImpl callInvokerHolder) {
+    return nativeInstallRuntime(jsiPtr, callInvokerHolder);
+  }
+
+  public static boolean uninstallRuntime(long jsiPtr) {
+    return nativeUninstallRuntime(jsiPtr);
+  }
+
   @Override
   public void invalidate() {
     super.invalidate();
@@ -0,0 +1,81 @@
+#pragma once
+#include "udp-core.h"
+#include <array>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace jsiudp {
+
+// Bounded LRU of formatted remote hosts keyed by the binary address (port
+// excluded), so a small, stable set of peers is formatted once.
+class AddressCache {
+public:
+  explicit AddressCache(size_t capacity = 64) : _capacity(capacity) {}
+
+  std::string lookup(const struct sockaddr_storage &addr) {
+    // AF_UNIX paths don't fit the key; they are cheap to format anyway
+    if (addr.ss_family == AF_UNIX) {
+      return formatAddress(addr);
+    }
+    auto key = makeKey(addr);
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+      _entries.splice(_entries.begin(), _entries, it->second);
+      return it->second->second;
+    }
+    _entries.emplace_front(key, formatAddress(addr));
+    _index[key] = _entries.begin();
+    if (_entries.size() > _capacity) {
+      _index.erase(_entries.back().first);
+      _entries.pop_back();
+    }
+    return _entries.front().second;
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+  }
+
+private:
+  // family byte followed by up to 16 address bytes
+  using Key = std::array<uint8_t, 17>;
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      size_t hash = 14695981039346656037ull;
+      for (auto byte : key) {
+        hash = (hash ^ byte) * 1099511628211ull;
+      }
+      return hash;
+    }
+  };
+
+  static Key makeKey(const struct sockaddr_storage &addr) {
+    Key key{};
+    key[0] = static_cast<uint8_t>(addr.ss_family);
+    if (addr.ss_family == AF_INET) {
+      auto &in = reinterpret_cast<const struct sockaddr_in &>(addr).sin_addr;
+      memcpy(&key[1], &in, sizeof(in));
+    } else if (addr.ss_family == AF_INET6) {
+      auto &in6 = reinterpret_cast<const struct sockaddr_in6 &>(addr).sin6_addr;
+      memcpy(&key[1], &in6, sizeof(in6));
+    }
+    return key;
+  }
+
+  size_t _capacity;
+  std::mutex _mutex;
+  std::list<std::pair<Key, std::string>> _entries;
+  std::unordered_map<Key, std::list<std::pair<Key, std::string>>::iterator,
+                     KeyHash>
+      _index;
+};
+
+} // namespace jsiudp
@@ -0,0 +1,129 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace jsiudp {
+namespace bench {
+
+inline uint64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Header stamped at the start of every benchmark payload.
+struct PacketHeader {
+  uint64_t sentNs;
+  uint32_t seq;
+};
+
+inline void stamp(std::string &payload, uint32_t seq) {
+  PacketHeader header{nowNs(), seq};
+  memcpy(&payload[0], &header, sizeof(header));
+}
+
+inline PacketHeader readStamp(const std::string &payload) {
+  PacketHeader header{};
+  if (payload.size() >= sizeof(header)) {
+    memcpy(&header, payload.data(), sizeof(header));
+  }
+  return header;
+}
+
+class LatencyStats {
+public:
+  void reserve(size_t n) { _samples.reserve(n); }
+  void add(uint64_t ns) { _samples.push_back(ns); }
+  size_t size() const { return _samples.size(); }
+
+  // Percentile in microseconds, p in [0, 100].
+  double percentileUs(double p) {
+    if (_samples.empty())
+      return 0;
+    if (!_sorted) {
+      std::sort(_samples.begin(), _samples.end());
+      _sorted = true;
+    }
+    auto index = static_cast<size_t>(p / 100.0 * (_samples.size() - 1) + 0.5);
+    return _samples[std::min(index, _samples.size() - 1)] / 1000.0;
+  }
+
+private:
+  std::vector<uint64_t> _samples;
+  bool _sorted = false;
+};
+
+struct Result {
+  std::string name;
+  size_t payload;
+  size_t sockets;
+  uint64_t sent;
+  uint64_t received;
+  double seconds;
+  LatencyStats latency;
+};
+
+inline void printHeader() {
+  printf("%-18s %7s %7s %9s %9s %11s %9s %9s %9s %9s\n", "case", "bytes",
+         "socks", "sent", "recv", "pkt/s", "MB/s", "p50(us)", "p99(us)",
+         "p999(us)");
+}
+
+inline void printResult(Result &r) {
+  double pps = r.seconds > 0 ? r.received / r.seconds : 0;
+  double mbps = pps * r.payload / (1024.0 * 1024.0);
+  printf("%-18s %7zu %7zu %9llu %9llu %11.0f %9.2f %9.1f %9.1f %9.1f\n",
+         r.name.c_str(), r.payload, r.sockets,
+         static_cast<unsigned long long>(r.sent),
+         static_cast<unsigned long long>(r.received), pps, mbps,
+         r.latency.percentileUs(50), r.latency.percentileUs(99),
+         r.latency.percentileUs(99.9));
+  fflush(stdout);
+}
+
+// Minimal "--name value" argument lookup.
+class Args {
+public:
+  Args(int argc, char **argv) : _args(argv + 1, argv + argc) {}
+
+  bool has(const std::string &name) const {
+    return std::find(_args.begin(), _args.end(), name) != _args.end();
+  }
+
+  std::string get(const std::string &name, const std::string &fallback) const {
+    auto it = std::find(_args.begin(), _args.end(), name);
+    if (it == _args.end() || it + 1 == _args.end())
+      return fallback;
+    return *(it + 1);
+  }
+
+  long getInt(const std::string &name, long fallback) const {
+    auto value = get(name, "");
+    return value.empty() ? fallback : strtol(value.c_str(), nullptr, 10);
+  }
+
+  std::vector<size_t> getList(const std::string &name,
+                              const std::string &fallback) const {
+    std::vector<size_t> values;
+    std::stringstream stream(get(name, fallback));
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+      if (!item.empty())
+        values.push_back(strtoul(item.c_str(), nullptr, 10));
+    }
+    return values;
+  }
+
+private:
+  std::vector<std::string> _args;
+};
+
+} // namespace bench
+} // namespace jsiudp
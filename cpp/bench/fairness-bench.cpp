@@ -0,0 +1,119 @@
+// Measures how much a flooded socket delays a sparse one sharing the poll
+// thread: one thread floods a receiver with large datagrams while the bench
+// thread pings a second receiver, across poller read budgets. `--work-us`
+// stands in for the per-message cost of the handler (JS dispatch).
+//
+//   jsiudp_fairness_bench [--pings N] [--gap-us N] [--work-us N]
+//                         [--budgets 0,64,16,4] [--quick]
+
+#include "bench-util.h"
+#include "udp-core.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+
+using namespace jsiudp;
+using namespace jsiudp::bench;
+
+namespace {
+
+void spinFor(uint64_t us) {
+  auto until = nowNs() + us * 1000;
+  while (nowNs() < until) {
+  }
+}
+
+void runCase(uint32_t budget, uint64_t pings, uint64_t gapUs,
+             uint64_t workUs) {
+  std::atomic<uint64_t> received{0};
+  std::atomic<uint64_t> flooded{0};
+  std::atomic<int> controlId{0};
+  LatencyStats latency;
+  latency.reserve(pings);
+
+  auto core = std::make_unique<UdpCore>(
+      [&](int id, Event &&event) {
+        if (event.type != MESSAGE)
+          return;
+        if (id == controlId.load(std::memory_order_relaxed)) {
+          latency.add(nowNs() - readStamp(event.data).sentNs);
+          received.fetch_add(1, std::memory_order_release);
+        } else {
+          flooded.fetch_add(1, std::memory_order_relaxed);
+          spinFor(workUs);
+        }
+      },
+      DispatchMode::Direct);
+  PollerConfig config;
+  config.readBudget = budget;
+  core->setPollerConfig(config);
+
+  auto flood = core->create(4);
+  core->setOpt(flood, SOL_SOCKET, SO_RCVBUF, 1024 * 1024);
+  core->bind(flood, 4, "127.0.0.1", 0);
+  auto floodPort = core->getSockName(flood, 4).port;
+  auto control = core->create(4);
+  core->bind(control, 4, "127.0.0.1", 0);
+  controlId = control;
+  auto controlPort = core->getSockName(control, 4).port;
+
+  std::atomic<bool> stop{false};
+  std::thread flooder([&] {
+    auto sender = core->create(4);
+    std::string data(1400, 'f');
+    while (!stop.load(std::memory_order_relaxed)) {
+      for (int i = 0; i < 64; i++) {
+        core->send(sender, 4, "127.0.0.1", floodPort, data.data(),
+                   data.size());
+      }
+      std::this_thread::yield();
+    }
+  });
+
+  std::string data(64, 'c');
+  uint64_t sent = 0;
+  auto start = nowNs();
+  while (sent < pings) {
+    stamp(data, static_cast<uint32_t>(sent));
+    core->send(control, 4, "127.0.0.1", controlPort, data.data(),
+               data.size());
+    sent++;
+    auto timeout = nowNs() + 100ull * 1000 * 1000;
+    while (received.load(std::memory_order_acquire) < sent &&
+           nowNs() < timeout) {
+      std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(gapUs));
+  }
+  auto elapsed = nowNs() - start;
+  stop = true;
+  flooder.join();
+  core.reset();
+
+  auto name = budget == 0 ? std::string("unlimited") : std::to_string(budget);
+  printf("%-10s %9llu %9llu %9.1f %9.1f %9.1f %9.1f %11.0f\n", name.c_str(),
+         static_cast<unsigned long long>(sent),
+         static_cast<unsigned long long>(received.load()),
+         latency.percentileUs(50), latency.percentileUs(90),
+         latency.percentileUs(99), latency.percentileUs(99.9),
+         elapsed > 0 ? flooded.load() * 1e9 / elapsed : 0.0);
+  fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Args args(argc, argv);
+  bool quick = args.has("--quick");
+  auto pings = args.getInt("--pings", quick ? 200 : 2000);
+  auto gapUs = args.getInt("--gap-us", 1000);
+  auto workUs = args.getInt("--work-us", 2);
+  auto budgets = args.getList("--budgets", "0,64,16,4");
+
+  printf("%-10s %9s %9s %9s %9s %9s %9s %11s\n", "budget", "sent", "recv",
+         "p50(us)", "p90(us)", "p99(us)", "p999(us)", "flood pkt/s");
+  for (auto budget : budgets) {
+    runCase(static_cast<uint32_t>(budget), pings, gapUs, workUs);
+  }
+  return 0;
+}
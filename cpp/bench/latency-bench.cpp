@@ -0,0 +1,123 @@
+// Compares delivery latency (sendto on the bench thread -> handler) across
+// poller and dispatch modes, for sparse traffic where the I/O threads would
+// otherwise go to sleep between packets. Also reports the CPU the process
+// burned, since the low-latency modes trade one for the other.
+//
+//   jsiudp_latency_bench [--packets N] [--gap-us N] [--spin-us N]
+//                        [--busy-poll-us N] [--priority N] [--cpus 2,3]
+//                        [--quick]
+
+#include "bench-util.h"
+#include "udp-core.h"
+#include <atomic>
+#include <memory>
+#include <sys/resource.h>
+#include <thread>
+
+using namespace jsiudp;
+using namespace jsiudp::bench;
+
+namespace {
+
+double cpuSeconds() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+struct Mode {
+  std::string name;
+  PollerConfig config;
+  DispatchMode dispatch;
+};
+
+void runCase(const Mode &mode, uint64_t packets, uint64_t gapUs) {
+  std::atomic<uint64_t> received{0};
+  LatencyStats latency;
+  latency.reserve(packets);
+
+  auto core = std::make_unique<UdpCore>(
+      [&](int, Event &&event) {
+        if (event.type != MESSAGE)
+          return;
+        latency.add(nowNs() - readStamp(event.data).sentNs);
+        received.fetch_add(1, std::memory_order_release);
+      },
+      mode.dispatch);
+  core->setPollerConfig(mode.config);
+
+  auto receiver = core->create(4);
+  core->bind(receiver, 4, "127.0.0.1", 0);
+  auto port = core->getSockName(receiver, 4).port;
+  auto sender = core->create(4);
+
+  std::string data(64, 'x');
+  uint64_t sent = 0;
+  auto cpuStart = cpuSeconds();
+  auto start = nowNs();
+  while (sent < packets) {
+    stamp(data, static_cast<uint32_t>(sent));
+    core->send(sender, 4, "127.0.0.1", port, data.data(), data.size());
+    sent++;
+    // One packet in flight at a time, then let the threads go idle
+    auto timeout = nowNs() + 100ull * 1000 * 1000;
+    while (received.load(std::memory_order_acquire) < sent &&
+           nowNs() < timeout) {
+      std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(gapUs));
+  }
+  auto elapsed = nowNs() - start;
+  auto cpu = cpuSeconds() - cpuStart;
+  core.reset();
+
+  printf("%-18s %9llu %9llu %9.1f %9.1f %9.1f %9.1f %7.0f%%\n",
+         mode.name.c_str(), static_cast<unsigned long long>(sent),
+         static_cast<unsigned long long>(received.load()),
+         latency.percentileUs(50), latency.percentileUs(90),
+         latency.percentileUs(99), latency.percentileUs(99.9),
+         elapsed > 0 ? cpu * 1e9 / elapsed * 100 : 0.0);
+  fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Args args(argc, argv);
+  bool quick = args.has("--quick");
+  auto packets = args.getInt("--packets", quick ? 500 : 5000);
+  auto gapUs = args.getInt("--gap-us", 200);
+  auto spinUs = static_cast<uint32_t>(args.getInt("--spin-us", 1000));
+  auto busyPollUs = static_cast<uint32_t>(args.getInt("--busy-poll-us", 50));
+
+  PollerConfig tuned;
+  if (args.has("--priority")) {
+    tuned.priority = static_cast<int>(args.getInt("--priority", 0));
+  }
+  for (auto cpu : args.getList("--cpus", "")) {
+    tuned.cpus.push_back(static_cast<int>(cpu));
+  }
+
+  auto spin = tuned;
+  spin.spinUs = spinUs;
+  auto busyPoll = spin;
+  busyPoll.busyPollUs = busyPollUs;
+
+  auto thread = DispatchMode::EventThread;
+  auto direct = DispatchMode::Direct;
+  std::vector<Mode> modes = {
+      {"blocking/thread", PollerConfig(), thread},
+      {"blocking/direct", PollerConfig(), direct},
+      {"spin/thread", spin, thread},
+      {"spin/direct", spin, direct},
+      {"spin+busy/direct", busyPoll, direct},
+  };
+
+  printf("%-18s %9s %9s %9s %9s %9s %9s %8s\n", "mode", "sent", "recv",
+         "p50(us)", "p90(us)", "p99(us)", "p999(us)", "cpu");
+  for (const auto &mode : modes) {
+    runCase(mode, packets, gapUs);
+  }
+  return 0;
+}
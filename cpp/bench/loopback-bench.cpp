@@ -0,0 +1,143 @@
+// Drives UdpCore over loopback UDP ("udp4") or AF_UNIX datagram sockets
+// ("unix") and reports throughput and delivery latency (sendto on the bench
+// thread -> handler), with events dispatched through the core event thread
+// ("thread") or straight from the poll thread ("direct").
+//
+//   jsiudp_bench [--packets N] [--sizes 64,512,1400] [--sockets 1,4,16]
+//                [--window N] [--dispatch thread,direct]
+//                [--transport udp4,unix] [--quick]
+
+#include "bench-util.h"
+#include "udp-core.h"
+#include <atomic>
+#include <memory>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace jsiudp;
+using namespace jsiudp::bench;
+
+namespace {
+
+struct Receiver {
+  std::atomic<uint64_t> received{0};
+  LatencyStats latency;
+};
+
+Result runCase(const std::string &transport, DispatchMode mode,
+               size_t payload, size_t sockets, uint64_t packets,
+               uint64_t window) {
+  Receiver receiver;
+  receiver.latency.reserve(packets);
+
+  // Handler calls are serialized in either mode, so the stats need no
+  // locking; the bench thread only reads them after `received` settles.
+  auto core = std::make_unique<UdpCore>(
+      [&receiver](int, Event &&event) {
+        if (event.type != MESSAGE)
+          return;
+        auto header = readStamp(event.data);
+        receiver.latency.add(nowNs() - header.sentNs);
+        receiver.received.fetch_add(1, std::memory_order_release);
+      },
+      mode);
+
+  // UDP receivers are told apart by port, AF_UNIX ones by path
+  auto type = transport == "unix" ? UNIX_DGRAM : 4;
+  std::vector<std::pair<std::string, int>> targets;
+  for (size_t i = 0; i < sockets; i++) {
+    auto id = core->create(type);
+    if (type == UNIX_DGRAM) {
+      auto path = "/tmp/jsiudp-bench-" + std::to_string(getpid()) + "-" +
+                  std::to_string(i) + ".sock";
+      core->bind(id, type, path, 0);
+      targets.emplace_back(path, 0);
+    } else {
+      core->bind(id, type, "127.0.0.1", 0);
+      targets.emplace_back("127.0.0.1", core->getSockName(id, type).port);
+    }
+  }
+  auto sender = core->create(type);
+  core->setOpt(sender, SOL_SOCKET, SO_SNDBUF, 4 * 1024 * 1024);
+
+  std::string data(std::max(payload, sizeof(PacketHeader)), 'x');
+  uint64_t sent = 0;
+  auto start = nowNs();
+  auto deadline = start + 10ull * 1000 * 1000 * 1000;
+  while (sent < packets && nowNs() < deadline) {
+    // Bound in-flight packets so we measure the receive path rather than
+    // kernel buffer overflow.
+    if (sent - receiver.received.load(std::memory_order_acquire) >= window) {
+      std::this_thread::yield();
+      continue;
+    }
+    stamp(data, static_cast<uint32_t>(sent));
+    auto &target = targets[sent % targets.size()];
+    try {
+      core->send(sender, type, target.first, target.second, data.data(),
+                 data.size());
+    } catch (const UdpError &) {
+      // AF_UNIX reports a full peer queue (EAGAIN) instead of dropping
+      std::this_thread::yield();
+      continue;
+    }
+    sent++;
+  }
+
+  // Allow stragglers to arrive; anything still missing was dropped.
+  auto settle = nowNs() + 500ull * 1000 * 1000;
+  while (receiver.received.load(std::memory_order_acquire) < sent &&
+         nowNs() < settle) {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  auto elapsed = nowNs() - start;
+  // Joins the core threads, so the handler can no longer touch `receiver`.
+  core.reset();
+
+  Result result{transport +
+                    (mode == DispatchMode::Direct ? "/direct" : "/thread"),
+                data.size(), sockets, sent,
+                receiver.received.load(std::memory_order_acquire),
+                elapsed / 1e9, LatencyStats()};
+  result.latency = std::move(receiver.latency);
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Args args(argc, argv);
+  bool quick = args.has("--quick");
+  auto packets = args.getInt("--packets", quick ? 2000 : 100000);
+  auto window = args.getInt("--window", 64);
+  auto sizes = args.getList("--sizes", quick ? "64,1400" : "64,512,1400,8192");
+  auto sockets = args.getList("--sockets", quick ? "1,4" : "1,4,16,64");
+  auto dispatch = args.get("--dispatch", "thread,direct");
+  auto transports = args.get("--transport", "udp4,unix");
+
+  std::vector<DispatchMode> modes;
+  if (dispatch.find("thread") != std::string::npos)
+    modes.push_back(DispatchMode::EventThread);
+  if (dispatch.find("direct") != std::string::npos)
+    modes.push_back(DispatchMode::Direct);
+
+  std::vector<std::string> kinds;
+  for (auto kind : {"udp4", "unix"}) {
+    if (transports.find(kind) != std::string::npos)
+      kinds.push_back(kind);
+  }
+
+  printHeader();
+  for (auto count : sockets) {
+    for (auto size : sizes) {
+      for (const auto &kind : kinds) {
+        for (auto mode : modes) {
+          auto result = runCase(kind, mode, size, count, packets, window);
+          printResult(result);
+        }
+      }
+    }
+  }
+  return 0;
+}
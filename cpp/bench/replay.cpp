@@ -0,0 +1,165 @@
+// Records loopback traffic through UdpCore's capture hook, or replays the UDP
+// payloads of a capture (pcapng from startCapture, or pcap / pcapng from
+// tcpdump) at the captured pace scaled by --speed (0: back to back). Without
+// --to, replayed datagrams go to a receiver in this process, which reports
+// what arrived: a repeatable load test of the receive path.
+//
+//   jsiudp_replay --record FILE [--packets N] [--size N] [--gap-us N]
+//   jsiudp_replay --replay FILE [--speed X] [--direction in|out|all]
+//                 [--port N] [--to HOST:PORT] [--dispatch thread|direct]
+//                 [--capture FILE]
+
+#include "bench-util.h"
+#include "packet-capture.h"
+#include "udp-core.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+
+using namespace jsiudp;
+using namespace jsiudp::bench;
+
+namespace {
+
+void waitFor(const std::atomic<uint64_t> &counter, uint64_t target) {
+  // Give up once nothing has arrived for a while
+  auto last = counter.load();
+  auto idleSince = nowNs();
+  while (counter.load() < target &&
+         nowNs() - idleSince < 500ull * 1000 * 1000) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (counter.load() != last) {
+      last = counter.load();
+      idleSince = nowNs();
+    }
+  }
+}
+
+void printCapture(const char *label, const std::optional<CaptureStats> &stats) {
+  if (stats) {
+    printf("%s: %llu packets, %llu bytes, %llu dropped\n", label,
+           static_cast<unsigned long long>(stats->packets),
+           static_cast<unsigned long long>(stats->bytes),
+           static_cast<unsigned long long>(stats->dropped));
+  }
+}
+
+int record(const std::string &path, uint64_t packets, size_t size,
+           uint64_t gapUs) {
+  std::atomic<uint64_t> received{0};
+  UdpCore core([&](int, Event &&event) {
+    if (event.type == MESSAGE)
+      received.fetch_add(1, std::memory_order_relaxed);
+  });
+  core.startCapture(path);
+
+  auto receiver = core.create(4);
+  core.bind(receiver, 4, "127.0.0.1", 0);
+  auto port = core.getSockName(receiver, 4).port;
+  auto sender = core.create(4);
+  core.bind(sender, 4, "127.0.0.1", 0);
+
+  std::string data(std::max<size_t>(size, sizeof(PacketHeader)), 'x');
+  for (uint64_t seq = 0; seq < packets; seq++) {
+    stamp(data, static_cast<uint32_t>(seq));
+    core.send(sender, 4, "127.0.0.1", port, data.data(), data.size());
+    if (gapUs > 0)
+      std::this_thread::sleep_for(std::chrono::microseconds(gapUs));
+  }
+  waitFor(received, packets);
+
+  printf("recorded %llu/%llu datagrams to port %d\n",
+         static_cast<unsigned long long>(received.load()),
+         static_cast<unsigned long long>(packets), port);
+  printCapture("capture", core.stopCapture());
+  return 0;
+}
+
+int replay(const std::string &path, const std::string &to,
+           const ReplayOptions &options, DispatchMode mode,
+           const std::string &capturePath) {
+  std::atomic<uint64_t> received{0};
+  std::atomic<uint64_t> bytes{0};
+  UdpCore core(
+      [&](int, Event &&event) {
+        if (event.type != MESSAGE)
+          return;
+        bytes.fetch_add(event.data.size(), std::memory_order_relaxed);
+        received.fetch_add(1, std::memory_order_relaxed);
+      },
+      mode);
+  if (!capturePath.empty()) {
+    core.startCapture(capturePath);
+  }
+
+  std::string host = "127.0.0.1";
+  int port = 0;
+  int receiver = 0;
+  if (to.empty()) {
+    receiver = core.create(4);
+    core.setOpt(receiver, SOL_SOCKET, SO_RCVBUF, 4 * 1024 * 1024);
+    core.bind(receiver, 4, host, 0);
+    port = core.getSockName(receiver, 4).port;
+  } else {
+    auto colon = to.rfind(':');
+    host = to.substr(0, colon);
+    port = atoi(to.c_str() + colon + 1);
+  }
+  auto type = host.find(':') != std::string::npos ? 6 : 4;
+  auto sender = core.create(type);
+
+  auto stats = replayCapture(core, sender, type, path, host, port, options);
+  if (receiver != 0) {
+    waitFor(received, stats.sent);
+  }
+
+  printf("sent %llu datagrams in %.3fs (%.0f pkt/s), skipped %llu, "
+         "failed %llu\n",
+         static_cast<unsigned long long>(stats.sent), stats.seconds,
+         stats.seconds > 0 ? stats.sent / stats.seconds : 0.0,
+         static_cast<unsigned long long>(stats.skipped),
+         static_cast<unsigned long long>(stats.failed));
+  if (receiver != 0) {
+    auto drops = core.getDropStats(receiver);
+    printf("received %llu (%llu bytes), lost %llu, kernel drops %s\n",
+           static_cast<unsigned long long>(received.load()),
+           static_cast<unsigned long long>(bytes.load()),
+           static_cast<unsigned long long>(stats.sent - received.load()),
+           drops.supported ? std::to_string(drops.drops).c_str() : "n/a");
+  }
+  printCapture("capture", core.stopCapture());
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Args args(argc, argv);
+  try {
+    if (args.has("--record")) {
+      return record(args.get("--record", ""), args.getInt("--packets", 1000),
+                    args.getInt("--size", 256), args.getInt("--gap-us", 100));
+    }
+    if (args.has("--replay")) {
+      ReplayOptions options;
+      options.speed = strtod(args.get("--speed", "1").c_str(), nullptr);
+      auto direction = args.get("--direction", "in");
+      if (direction == "out") {
+        options.direction = CaptureDirection::Outbound;
+      } else if (direction == "all") {
+        options.direction.reset();
+      }
+      options.port = args.getInt("--port", 0);
+      auto mode = args.get("--dispatch", "direct") == "thread"
+                      ? DispatchMode::EventThread
+                      : DispatchMode::Direct;
+      return replay(args.get("--replay", ""), args.get("--to", ""), options,
+                    mode, args.get("--capture", ""));
+    }
+  } catch (const UdpError &e) {
+    fprintf(stderr, "error: %s\n", e.what());
+    return 1;
+  }
+  fprintf(stderr, "usage: jsiudp_replay --record FILE | --replay FILE\n");
+  return 2;
+}
@@ -0,0 +1,198 @@
+// Measures how a busy main JS queue delays a latency-sensitive socket, with
+// the socket routed to the shared invoker, to the shared invoker in the
+// high-priority lane, or to its own (secondary runtime) invoker. JS runtimes
+// are replaced by mock invokers: one worker thread each.
+//
+//   jsiudp_routing_bench [--packets N] [--work-us N] [--bulk-ratio N]
+//                        [--window N]
+
+#include "bench-util.h"
+#include "event-router.h"
+#include "udp-core.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace jsiudp;
+using namespace jsiudp::bench;
+
+namespace {
+
+// Stand-in for a CallInvoker: runs posted work in order on its own thread.
+class MockInvoker {
+public:
+  MockInvoker() : _thread(&MockInvoker::run, this) {}
+
+  ~MockInvoker() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _cond.notify_one();
+    _thread.join();
+  }
+
+  void invokeAsync(std::function<void()> &&f) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _queue.push_back(std::move(f));
+    }
+    _cond.notify_one();
+  }
+
+private:
+  void run() {
+    while (true) {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cond.wait(lock, [this] { return _stop || !_queue.empty(); });
+      if (_stop)
+        return;
+      auto f = std::move(_queue.front());
+      _queue.pop_front();
+      lock.unlock();
+      f();
+    }
+  }
+
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::deque<std::function<void()>> _queue;
+  bool _stop = false;
+  std::thread _thread;
+};
+
+// Stand-in for RuntimeTarget: hands each event to a callback on the invoker,
+// reporting normal-priority ones back to the core once run.
+class MockTarget : public EventTarget {
+public:
+  using Callback = std::function<void(int id, const Event &event)>;
+
+  MockTarget(std::shared_ptr<MockInvoker> invoker, Callback callback,
+             std::function<void(size_t)> onConsumed)
+      : _invoker(std::move(invoker)), _callback(std::move(callback)),
+        _onConsumed(std::move(onConsumed)) {}
+
+  void deliver(int id, Event &&event) override {
+    auto windowed = event.windowed;
+    _invoker->invokeAsync([callback = _callback, onConsumed = _onConsumed,
+                           windowed, id, event = std::move(event)]() {
+      callback(id, event);
+      if (windowed) {
+        onConsumed(1);
+      }
+    });
+  }
+
+private:
+  std::shared_ptr<MockInvoker> _invoker;
+  Callback _callback;
+  std::function<void(size_t)> _onConsumed;
+};
+
+void spin(uint64_t us) {
+  auto until = nowNs() + us * 1000;
+  while (nowNs() < until) {
+  }
+}
+
+Result runCase(const char *name, bool ownInvoker, bool highPriority,
+               uint64_t packets, uint64_t workUs, uint64_t bulkRatio,
+               uint64_t window) {
+  std::atomic<uint64_t> received{0};
+  LatencyStats latency;
+  latency.reserve(packets);
+
+  EventRouter router;
+  auto core = std::make_unique<UdpCore>([&router](int id, Event &&event) {
+    router.dispatch(id, std::move(event));
+  });
+
+  auto mainInvoker = std::make_shared<MockInvoker>();
+  auto workerInvoker =
+      ownInvoker ? std::make_shared<MockInvoker>() : mainInvoker;
+
+  // Bulk traffic costs the main runtime `workUs` of JS time per packet
+  auto bulkTarget = std::make_shared<MockTarget>(
+      mainInvoker, [workUs](int, const Event &) { spin(workUs); },
+      core->consumer());
+  auto controlTarget = std::make_shared<MockTarget>(
+      workerInvoker,
+      [&](int, const Event &event) {
+        latency.add(nowNs() - readStamp(event.data).sentNs);
+        received.fetch_add(1, std::memory_order_release);
+      },
+      core->consumer());
+
+  auto bulk = core->create(4);
+  core->bind(bulk, 4, "127.0.0.1", 0);
+  router.route(bulk, bulkTarget);
+  auto control = core->create(4);
+  core->bind(control, 4, "127.0.0.1", 0);
+  router.route(control, controlTarget);
+  if (highPriority) {
+    DeliveryConfig config;
+    config.normalWindow = window;
+    core->setDeliveryConfig(config);
+    core->setPriority(control, Priority::High);
+  }
+  auto bulkPort = core->getSockName(bulk, 4).port;
+  auto controlPort = core->getSockName(control, 4).port;
+  auto sender = core->create(4);
+
+  std::string data(64, 'x');
+  auto start = nowNs();
+  for (uint64_t seq = 0; seq < packets; seq++) {
+    for (uint64_t i = 0; i < bulkRatio; i++) {
+      core->send(sender, 4, "127.0.0.1", bulkPort, data.data(), data.size());
+    }
+    stamp(data, static_cast<uint32_t>(seq));
+    core->send(sender, 4, "127.0.0.1", controlPort, data.data(), data.size());
+    // Pace control packets so bulk work has time to back up the main queue
+    spin(workUs * bulkRatio / 2);
+  }
+
+  auto settle = nowNs() + 5ull * 1000 * 1000 * 1000;
+  while (received.load(std::memory_order_acquire) < packets &&
+         nowNs() < settle) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  auto elapsed = nowNs() - start;
+  core.reset();
+  workerInvoker.reset();
+  mainInvoker.reset();
+  bulkTarget.reset();
+  controlTarget.reset();
+
+  Result result{name, data.size(), 2, packets,
+                received.load(std::memory_order_acquire), elapsed / 1e9,
+                LatencyStats()};
+  result.latency = std::move(latency);
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Args args(argc, argv);
+  bool quick = args.has("--quick");
+  auto packets = args.getInt("--packets", quick ? 200 : 2000);
+  auto workUs = args.getInt("--work-us", 200);
+  auto bulkRatio = args.getInt("--bulk-ratio", 4);
+  auto window = args.getInt("--window", DeliveryConfig().normalWindow);
+
+  printHeader();
+  auto shared = runCase("shared-invoker", false, false, packets, workUs,
+                        bulkRatio, window);
+  printResult(shared);
+  auto priority = runCase("high-priority", false, true, packets, workUs,
+                          bulkRatio, window);
+  printResult(priority);
+  auto own = runCase("own-invoker", true, false, packets, workUs, bulkRatio,
+                     window);
+  printResult(own);
+  return 0;
+}
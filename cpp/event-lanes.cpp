@@ -0,0 +1,116 @@
+#include "event-lanes.h"
+#include <algorithm>
+
+namespace jsiudp {
+
+void EventLanes::push(Event &&event, Clock::time_point now) {
+  auto &lane = event.priority == Priority::High ? _high : _normal;
+  lane.queue.push_back({std::move(event), now});
+  lane.maxDepth = std::max(lane.maxDepth, lane.queue.size());
+}
+
+bool EventLanes::windowOpen() const {
+  return !_throttled || _config.normalWindow == 0 ||
+         _inFlight < _config.normalWindow;
+}
+
+bool EventLanes::stalled(Clock::time_point now) const {
+  return now - _lastProgress >=
+         std::chrono::microseconds(_config.windowTimeoutUs);
+}
+
+size_t EventLanes::ready(Clock::time_point now) const {
+  auto normal = _normal.queue.size();
+  if (normal > 0 && !windowOpen() && !stalled(now)) {
+    normal = 0;
+  }
+  return _high.queue.size() + normal;
+}
+
+void EventLanes::takeFront(Lane &lane, Clock::time_point now,
+                           std::vector<Event> &out) {
+  auto &front = lane.queue.front();
+  auto waitUs = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(now -
+                                                            front.queuedAt)
+          .count());
+  lane.delivered++;
+  lane.totalWaitUs += waitUs;
+  lane.maxWaitUs = std::max(lane.maxWaitUs, waitUs);
+  out.push_back(std::move(front.event));
+  lane.queue.pop_front();
+}
+
+void EventLanes::take(Clock::time_point now, std::vector<Event> &out) {
+  out.reserve(out.size() + _high.queue.size() + _normal.queue.size());
+  while (!_high.queue.empty()) {
+    takeFront(_high, now, out);
+  }
+  if (!_normal.queue.empty() && !windowOpen() && stalled(now)) {
+    // Whatever is still counted was most likely dropped unreported
+    _inFlight = 0;
+  }
+  while (!_normal.queue.empty() && windowOpen()) {
+    takeFront(_normal, now, out);
+    // Only events charged here are acked; others would over-count
+    if (_throttled) {
+      out.back().windowed = true;
+      _inFlight++;
+      _lastProgress = now;
+    }
+  }
+}
+
+void EventLanes::drain(std::vector<Event> &out) {
+  out.reserve(out.size() + _high.queue.size() + _normal.queue.size());
+  for (auto lane : {&_high, &_normal}) {
+    for (auto &queued : lane->queue) {
+      out.push_back(std::move(queued.event));
+    }
+    lane->queue.clear();
+  }
+}
+
+void EventLanes::consumed(size_t count) {
+  _inFlight -= std::min(count, _inFlight);
+  _lastProgress = Clock::now();
+}
+
+std::optional<EventLanes::Clock::time_point> EventLanes::nextAging() const {
+  if (_normal.queue.empty() || windowOpen()) {
+    return std::nullopt;
+  }
+  return _lastProgress + std::chrono::microseconds(_config.windowTimeoutUs);
+}
+
+void EventLanes::setThrottled(bool throttled) {
+  // Windowed events still in flight keep their count; their acks come in
+  // either way
+  _throttled = throttled;
+}
+
+LaneStats EventLanes::laneStats(Lane &lane, bool reset) {
+  LaneStats stats;
+  stats.depth = lane.queue.size();
+  stats.maxDepth = lane.maxDepth;
+  stats.delivered = lane.delivered;
+  stats.avgWaitUs = lane.delivered > 0 ? lane.totalWaitUs / lane.delivered : 0;
+  stats.maxWaitUs = lane.maxWaitUs;
+  if (reset) {
+    lane.maxDepth = lane.queue.size();
+    lane.delivered = 0;
+    lane.totalWaitUs = 0;
+    lane.maxWaitUs = 0;
+  }
+  return stats;
+}
+
+DeliveryStats EventLanes::stats(bool reset) {
+  DeliveryStats stats;
+  stats.high = laneStats(_high, reset);
+  stats.normal = laneStats(_normal, reset);
+  stats.inFlight = _inFlight;
+  return stats;
+}
+
+} // namespace jsiudp
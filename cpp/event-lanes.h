@@ -0,0 +1,63 @@
+#pragma once
+#include "udp-core.h"
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <vector>
+
+namespace jsiudp {
+
+// Two-lane event queue. High-priority events always go out first; normal
+// ones are held back once `normalWindow` of them are in flight. The window
+// only applies while throttled (some socket has high priority). Not
+// thread-safe, the owner serializes access.
+class EventLanes {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  void push(Event &&event, Clock::time_point now);
+  // Number of events take() would hand out at `now`
+  size_t ready(Clock::time_point now) const;
+  // Moves high-priority events, then the normal ones the window allows, into
+  // `out`.
+  void take(Clock::time_point now, std::vector<Event> &out);
+  // Moves every queued event into `out`, high-priority ones first, whatever
+  // the window; they are not counted as delivered.
+  void drain(std::vector<Event> &out);
+  // Windowed events processed downstream, or dropped before delivery
+  void consumed(size_t count);
+  // When a full window holding back normal events times out
+  std::optional<Clock::time_point> nextAging() const;
+
+  void setConfig(const DeliveryConfig &config) { _config = config; }
+  void setThrottled(bool throttled);
+  DeliveryStats stats(bool reset);
+
+private:
+  struct Queued {
+    Event event;
+    Clock::time_point queuedAt;
+  };
+  struct Lane {
+    std::deque<Queued> queue;
+    size_t maxDepth = 0;
+    uint64_t delivered = 0;
+    uint64_t totalWaitUs = 0;
+    uint64_t maxWaitUs = 0;
+  };
+
+  bool windowOpen() const;
+  bool stalled(Clock::time_point now) const;
+  void takeFront(Lane &lane, Clock::time_point now, std::vector<Event> &out);
+  static LaneStats laneStats(Lane &lane, bool reset);
+
+  DeliveryConfig _config;
+  bool _throttled = false;
+  size_t _inFlight = 0;
+  // Last time the window moved: events handed out or reported consumed
+  Clock::time_point _lastProgress;
+  Lane _high;
+  Lane _normal;
+};
+
+} // namespace jsiudp
@@ -0,0 +1,108 @@
+#pragma once
+#include "udp-core.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace jsiudp {
+
+// Where a socket's events end up, e.g. a JS runtime and its call invoker.
+// Called from the core's dispatching thread and must not block.
+class EventTarget {
+public:
+  virtual ~EventTarget() = default;
+  virtual void deliver(int id, Event &&event) = 0;
+  // Targets that can hand several events over at once (e.g. one
+  // invokeAsync) override this.
+  virtual void deliverBatch(EventBatch &&batch) {
+    for (auto &[id, event] : batch) {
+      deliver(id, std::move(event));
+    }
+  }
+};
+
+// Maps socket ids to the target that owns their callbacks, so sockets can be
+// served by runtimes other than the main one. Events of sockets without a
+// route (closed, or owned by a removed target) are dropped.
+class EventRouter {
+public:
+  void route(int id, std::shared_ptr<EventTarget> target) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _routes[id] = std::move(target);
+  }
+
+  void unroute(int id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _routes.erase(id);
+  }
+
+  // Drop a target that is going away. Returns the ids of the sockets it
+  // owned, which no longer receive events; the caller should close them.
+  std::vector<int> removeTarget(const EventTarget *target) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<int> ids;
+    for (auto it = _routes.begin(); it != _routes.end();) {
+      if (it->second.get() == target) {
+        ids.push_back(it->first);
+        it = _routes.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    return ids;
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _routes.clear();
+  }
+
+  void dispatch(int id, Event &&event) {
+    std::shared_ptr<EventTarget> target;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      auto it = _routes.find(id);
+      if (it != _routes.end()) {
+        target = it->second;
+      }
+    }
+    if (target) {
+      target->deliver(id, std::move(event));
+    }
+  }
+
+  // Split a batch per target, keeping each target's events in order.
+  void dispatchBatch(EventBatch &&batch) {
+    std::vector<std::pair<std::shared_ptr<EventTarget>, EventBatch>> groups;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      for (auto &item : batch) {
+        auto it = _routes.find(item.first);
+        if (it == _routes.end()) {
+          continue;
+        }
+        auto &target = it->second;
+        auto group = std::find_if(
+            groups.begin(), groups.end(),
+            [&target](const auto &group) { return group.first == target; });
+        if (group == groups.end()) {
+          groups.emplace_back(target, EventBatch());
+          group = groups.end() - 1;
+        }
+        group->second.push_back(std::move(item));
+      }
+    }
+    for (auto &[target, events] : groups) {
+      target->deliverBatch(std::move(events));
+    }
+  }
+
+private:
+  std::mutex _mutex;
+  std::unordered_map<int, std::shared_ptr<EventTarget>> _routes;
+};
+
+} // namespace jsiudp
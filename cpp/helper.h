@@ -1,9 +1,12 @@
 #pragma once
 
+// Not every host function reads all of its arguments
 #define JSI_HOST_FUNCTION(NAME)                                                \
   facebook::jsi::Value NAME(                                                   \
-      facebook::jsi::Runtime &runtime, const facebook::jsi::Value &thisValue,  \
-      const facebook::jsi::Value *arguments, size_t count)
+      [[maybe_unused]] facebook::jsi::Runtime &runtime,                        \
+      [[maybe_unused]] const facebook::jsi::Value &thisValue,                  \
+      [[maybe_unused]] const facebook::jsi::Value *arguments,                  \
+      [[maybe_unused]] size_t count)
 
 #define EXPOSE_FN(RUNTIME, NAME, ARGC, FUNCTION)                               \
   {                                                                            \
@@ -13,6 +16,17 @@
     (RUNTIME).global().setProperty((RUNTIME), #NAME, std::move(NAME));         \
   }
 
+// The host function holds its object weakly (the class derives from
+// enable_shared_from_this): it may outlive the object in the runtime, and
+// then throws instead of touching freed memory.
 #define BIND_METHOD(METHOD)                                                    \
-  std::bind(&METHOD, this, std::placeholders::_1, std::placeholders::_2,       \
-            std::placeholders::_3, std::placeholders::_4)
+  [weak = weak_from_this()](facebook::jsi::Runtime &runtime,                   \
+                            const facebook::jsi::Value &thisValue,             \
+                            const facebook::jsi::Value *arguments,             \
+                            size_t count) -> facebook::jsi::Value {            \
+    auto self = weak.lock();                                                   \
+    if (!self) {                                                               \
+      throw facebook::jsi::JSError(runtime, "E_NOT_INSTALLED");                \
+    }                                                                          \
+    return (self.get()->*(&METHOD))(runtime, thisValue, arguments, count);     \
+  }
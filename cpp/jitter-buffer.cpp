@@ -0,0 +1,169 @@
+#include "jitter-buffer.h"
+#include <algorithm>
+#include <limits>
+
+namespace jsiudp {
+
+static bool readField(const std::string &data, size_t offset, size_t bytes,
+                      uint64_t &value) {
+  if (bytes == 0 || bytes > 8 || offset + bytes > data.size()) {
+    return false;
+  }
+  value = 0;
+  for (size_t i = 0; i < bytes; i++) {
+    value = (value << 8) | static_cast<uint8_t>(data[offset + i]);
+  }
+  return true;
+}
+
+// Extend a wrapping counter to 64 bits, picking the value closest to the
+// reference.
+static int64_t unwrap(uint64_t raw, int64_t reference, size_t bytes) {
+  if (bytes >= 8) {
+    return static_cast<int64_t>(raw);
+  }
+  auto range = int64_t(1) << (bytes * 8);
+  auto value = (reference & ~(range - 1)) + static_cast<int64_t>(raw);
+  if (value - reference > range / 2) {
+    value -= range;
+  } else if (reference - value > range / 2) {
+    value += range;
+  }
+  return value;
+}
+
+JitterBuffer::JitterBuffer(const JitterConfig &config)
+    : _config(config),
+      _played(std::max<size_t>(config.window, 1),
+              std::numeric_limits<int64_t>::min()) {}
+
+bool JitterBuffer::push(Event &event, Clock::time_point now) {
+  uint64_t rawSeq = 0;
+  uint64_t rawTs = 0;
+  auto hasTs = _config.timestampOffset >= 0 && _config.clockRate > 0;
+  if (!readField(event.data, _config.seqOffset, _config.seqBytes, rawSeq) ||
+      (hasTs && !readField(event.data, _config.timestampOffset,
+                           _config.timestampBytes, rawTs))) {
+    return false;
+  }
+  _stats.received++;
+
+  auto window = static_cast<int64_t>(_played.size());
+  auto seq = unwrap(rawSeq, _highest, _config.seqBytes);
+  if (!_started || seq - _highest > window || _next - seq > window) {
+    // First packet, or a jump too large to be reordering: start over
+    restart(seq);
+    _anchorTs = _highestTs = static_cast<int64_t>(rawTs);
+  }
+
+  auto &played = _played[((seq % window) + window) % window];
+  if (seq < _next) {
+    if (played == seq) {
+      _stats.duplicates++;
+    } else {
+      _stats.late++;
+    }
+    return true;
+  }
+  if (_slots.count(seq) != 0) {
+    _stats.duplicates++;
+    return true;
+  }
+  if (seq < _highest) {
+    _stats.reordered++;
+  }
+  _highest = std::max(_highest, seq);
+
+  auto due = dueTime(seq, rawTs, hasTs, now);
+  _slots.emplace(seq, Slot{std::move(event), due});
+  return true;
+}
+
+JitterBuffer::Clock::time_point JitterBuffer::dueTime(int64_t seq,
+                                                      uint64_t rawTimestamp,
+                                                      bool hasTs,
+                                                      Clock::time_point now) {
+  auto delay = std::chrono::microseconds(_config.playoutDelayUs);
+  std::chrono::microseconds offset;
+  if (hasTs) {
+    auto ts = unwrap(rawTimestamp, _highestTs, _config.timestampBytes);
+    _highestTs = std::max(_highestTs, ts);
+    offset = std::chrono::microseconds((ts - _anchorTs) * 1000000 /
+                                       _config.clockRate);
+  } else if (_config.packetIntervalUs > 0) {
+    offset = std::chrono::microseconds((seq - _anchorSeq) *
+                                       _config.packetIntervalUs);
+  } else {
+    return now + delay;
+  }
+
+  // Schedule along the quickest path seen over the last window of arrivals,
+  // so the delay only absorbs jitter. Taking the minimum over a sliding
+  // window rather than all time lets a sender whose clock runs slow (or
+  // fast) against ours pull the path along instead of using up the delay.
+  auto base = now - offset;
+  if (!_bases.empty() && base - _bases.front().second > delay) {
+    // Already overdue: the path moved (e.g. a stall), so re-anchor here
+    // instead of releasing everything early until the window catches up.
+    _bases.clear();
+  }
+  while (!_bases.empty() && _bases.back().second >= base) {
+    _bases.pop_back();
+  }
+  _bases.emplace_back(_arrivals, base);
+  while (_bases.front().first + _played.size() <= _arrivals) {
+    _bases.pop_front();
+  }
+  _arrivals++;
+  return _bases.front().second + offset + delay;
+}
+
+void JitterBuffer::restart(int64_t seq) {
+  for (auto &[key, slot] : _slots) {
+    _flush.push_back(std::move(slot));
+  }
+  _slots.clear();
+  _bases.clear();
+  std::fill(_played.begin(), _played.end(),
+            std::numeric_limits<int64_t>::min());
+  _started = true;
+  _next = _highest = _anchorSeq = seq;
+}
+
+void JitterBuffer::pop(Clock::time_point now, std::vector<Event> &out) {
+  for (auto &slot : _flush) {
+    out.push_back(std::move(slot.event));
+    _stats.released++;
+  }
+  _flush.clear();
+
+  auto window = static_cast<int64_t>(_played.size());
+  while (!_slots.empty()) {
+    auto it = _slots.begin();
+    // Past the window the oldest packet goes out early rather than growing
+    if (it->second.due > now && _slots.size() <= _played.size()) {
+      break;
+    }
+    auto seq = it->first;
+    if (seq > _next) {
+      _stats.lost += seq - _next;
+    }
+    _next = seq + 1;
+    _played[((seq % window) + window) % window] = seq;
+    out.push_back(std::move(it->second.event));
+    _stats.released++;
+    _slots.erase(it);
+  }
+}
+
+std::optional<JitterBuffer::Clock::time_point> JitterBuffer::nextDue() const {
+  if (!_flush.empty() || _slots.size() > _played.size()) {
+    return Clock::time_point::min();
+  }
+  if (_slots.empty()) {
+    return std::nullopt;
+  }
+  return _slots.begin()->second.due;
+}
+
+} // namespace jsiudp
@@ -0,0 +1,61 @@
+#pragma once
+#include "udp-core.h"
+#include <chrono>
+#include <deque>
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace jsiudp {
+
+// Per-socket reorder buffer. Packets are keyed by their (unwrapped) sequence
+// number and released in order once their playout time has passed; a gap
+// that is still open when a later packet is due counts as lost. Not
+// thread-safe, the owner serializes access.
+class JitterBuffer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit JitterBuffer(const JitterConfig &config);
+
+  // Takes the packet unless its header can't be parsed, in which case the
+  // caller should deliver it as is. Late and duplicate packets are taken and
+  // dropped.
+  bool push(Event &event, Clock::time_point now);
+  // Moves packets due at `now` into `out`, in sequence order.
+  void pop(Clock::time_point now, std::vector<Event> &out);
+  std::optional<Clock::time_point> nextDue() const;
+  JitterStats stats() const { return _stats; }
+
+private:
+  struct Slot {
+    Event event;
+    Clock::time_point due;
+  };
+
+  Clock::time_point dueTime(int64_t seq, uint64_t rawTimestamp, bool hasTs,
+                            Clock::time_point now);
+  void restart(int64_t seq);
+
+  JitterConfig _config;
+  JitterStats _stats;
+  std::map<int64_t, Slot> _slots;
+  // Slots left over from before a stream restart, released first
+  std::vector<Slot> _flush;
+  // Sequence numbers played out recently, to tell duplicates from late ones
+  std::vector<int64_t> _played;
+
+  bool _started = false;
+  int64_t _next = 0;
+  int64_t _highest = 0;
+  int64_t _highestTs = 0;
+  int64_t _anchorSeq = 0;
+  int64_t _anchorTs = 0;
+  // Send time implied by each recent arrival (arrival minus the packet's
+  // offset from the anchor), kept as a monotonic queue so the front is the
+  // earliest of the last `window` arrivals.
+  std::deque<std::pair<uint64_t, Clock::time_point>> _bases;
+  uint64_t _arrivals = 0;
+};
+
+} // namespace jsiudp
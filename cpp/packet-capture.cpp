@@ -0,0 +1,660 @@
+#include "packet-capture.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+namespace jsiudp {
+
+// pcapng block types and the link type of a bare IP packet
+constexpr uint32_t SECTION_HEADER = 0x0A0D0D0A;
+constexpr uint32_t INTERFACE_DESCRIPTION = 1;
+constexpr uint32_t ENHANCED_PACKET = 6;
+constexpr uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+constexpr uint16_t LINKTYPE_RAW = 101;
+
+constexpr uint16_t EPB_FLAGS = 2;
+constexpr uint32_t FLAG_INBOUND = 1;
+constexpr uint32_t FLAG_OUTBOUND = 2;
+
+constexpr size_t UDP_HEADER = 8;
+constexpr size_t IPV4_HEADER = 20;
+constexpr size_t IPV6_HEADER = 40;
+
+// Wake the writer early once this much is buffered
+constexpr size_t WRITE_THRESHOLD = 64 * 1024;
+constexpr auto WRITE_INTERVAL = std::chrono::milliseconds(100);
+
+template <typename T> static void append(std::string &out, T value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void pad(std::string &out) {
+  out.append((4 - out.size() % 4) % 4, '\0');
+}
+
+static uint32_t checksumAdd(uint32_t sum, const void *data, size_t size) {
+  auto *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i + 1 < size; i += 2) {
+    sum += (bytes[i] << 8) | bytes[i + 1];
+  }
+  if (size % 2 != 0) {
+    sum += bytes[size - 1] << 8;
+  }
+  return sum;
+}
+
+static uint16_t checksumFinish(uint32_t sum) {
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return htons(static_cast<uint16_t>(~sum));
+}
+
+static int portOf(const struct sockaddr_storage &addr) {
+  return addr.ss_family == AF_INET
+             ? reinterpret_cast<const struct sockaddr_in &>(addr).sin_port
+             : reinterpret_cast<const struct sockaddr_in6 &>(addr).sin6_port;
+}
+
+// Append an IP + UDP header for `size` payload bytes going from `src` to
+// `dst`, both of `family`. The UDP checksum covers `payload`, which may be
+// truncated, in which case it is left out (0).
+static void appendHeaders(std::string &out, int family,
+                          const struct sockaddr_storage &src,
+                          const struct sockaddr_storage &dst, int tos,
+                          size_t size, const std::string &payload) {
+  uint16_t udpLength = static_cast<uint16_t>(UDP_HEADER + size);
+  uint16_t udp[4] = {static_cast<uint16_t>(portOf(src)),
+                     static_cast<uint16_t>(portOf(dst)), htons(udpLength), 0};
+  uint8_t trafficClass = tos >= 0 ? static_cast<uint8_t>(tos) : 0;
+  uint32_t sum = 0;
+
+  if (family == AF_INET) {
+    auto &srcAddr = reinterpret_cast<const struct sockaddr_in &>(src).sin_addr;
+    auto &dstAddr = reinterpret_cast<const struct sockaddr_in &>(dst).sin_addr;
+    uint8_t ip[IPV4_HEADER] = {0x45, trafficClass};
+    uint16_t total = htons(static_cast<uint16_t>(IPV4_HEADER + udpLength));
+    memcpy(ip + 2, &total, 2);
+    ip[8] = 64; // TTL
+    ip[9] = IPPROTO_UDP;
+    memcpy(ip + 12, &srcAddr, 4);
+    memcpy(ip + 16, &dstAddr, 4);
+    auto ipSum = checksumFinish(checksumAdd(0, ip, sizeof(ip)));
+    memcpy(ip + 10, &ipSum, 2);
+    out.append(reinterpret_cast<const char *>(ip), sizeof(ip));
+    sum = checksumAdd(sum, &srcAddr, 4);
+    sum = checksumAdd(sum, &dstAddr, 4);
+  } else {
+    auto &srcAddr =
+        reinterpret_cast<const struct sockaddr_in6 &>(src).sin6_addr;
+    auto &dstAddr =
+        reinterpret_cast<const struct sockaddr_in6 &>(dst).sin6_addr;
+    uint8_t ip[IPV6_HEADER] = {
+        static_cast<uint8_t>(0x60 | (trafficClass >> 4)),
+        static_cast<uint8_t>((trafficClass & 0x0f) << 4)};
+    uint16_t length = htons(udpLength);
+    memcpy(ip + 4, &length, 2);
+    ip[6] = IPPROTO_UDP;
+    ip[7] = 64; // hop limit
+    memcpy(ip + 8, &srcAddr, 16);
+    memcpy(ip + 24, &dstAddr, 16);
+    out.append(reinterpret_cast<const char *>(ip), sizeof(ip));
+    sum = checksumAdd(sum, &srcAddr, 16);
+    sum = checksumAdd(sum, &dstAddr, 16);
+  }
+
+  if (payload.size() == size) {
+    sum += IPPROTO_UDP + udpLength;
+    sum = checksumAdd(sum, udp, sizeof(udp));
+    sum = checksumAdd(sum, payload.data(), payload.size());
+    udp[3] = checksumFinish(sum);
+    if (udp[3] == 0) {
+      udp[3] = 0xffff;
+    }
+  }
+  out.append(reinterpret_cast<const char *>(udp), sizeof(udp));
+}
+
+PacketCapture::PacketCapture(const std::string &path,
+                             const CaptureConfig &config)
+    : _config(config), _file(fopen(path.c_str(), "wb")) {
+  if (!_file) {
+    throw UdpError(error_name(errno));
+  }
+  std::string header;
+  append<uint32_t>(header, SECTION_HEADER);
+  append<uint32_t>(header, 28);
+  append<uint32_t>(header, BYTE_ORDER_MAGIC);
+  append<uint16_t>(header, 1);
+  append<uint16_t>(header, 0);
+  append<int64_t>(header, -1); // Section length not known up front
+  append<uint32_t>(header, 28);
+
+  // One interface for everything; timestamps default to microseconds
+  append<uint32_t>(header, INTERFACE_DESCRIPTION);
+  append<uint32_t>(header, 20);
+  append<uint16_t>(header, LINKTYPE_RAW);
+  append<uint16_t>(header, 0);
+  append<uint32_t>(header, 0); // No snap length limit
+  append<uint32_t>(header, 20);
+
+  if (fwrite(header.data(), 1, header.size(), _file) != header.size()) {
+    auto err = errno;
+    fclose(_file);
+    throw UdpError(error_name(err));
+  }
+  _thread = std::thread(&PacketCapture::run, this);
+}
+
+PacketCapture::~PacketCapture() {
+  finish();
+  fclose(_file);
+}
+
+void PacketCapture::finish() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopped = true;
+  }
+  _cond.notify_one();
+  if (_thread.joinable()) {
+    _thread.join();
+  }
+}
+
+void PacketCapture::record(CaptureDirection direction, int fd,
+                           const struct sockaddr_storage &remote,
+                           const struct sockaddr_storage &local, int tos,
+                           const void *data, size_t size) {
+  if (remote.ss_family != AF_INET && remote.ss_family != AF_INET6) {
+    return;
+  }
+  auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+                 std::chrono::system_clock::now().time_since_epoch())
+                 .count();
+  auto kept = _config.snapLen > 0 ? std::min(size, _config.snapLen) : size;
+  // Addresses and timestamps take more memory than a short payload
+  auto charged = sizeof(Record) + kept;
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (_stopped) {
+    return;
+  }
+  if (_failed || _pendingBytes + charged > _config.bufferBytes) {
+    _stats.dropped++;
+    return;
+  }
+  Record record{static_cast<uint64_t>(now), direction, remote, local, tos,
+                size, std::string(static_cast<const char *>(data), kept)};
+  if (local.ss_family == 0) {
+    auto bound = _boundAddresses.find(fd);
+    if (bound == _boundAddresses.end()) {
+      struct sockaddr_storage addr;
+      socklen_t len = sizeof(addr);
+      memset(&addr, 0, sizeof(addr));
+      getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr), &len);
+      // Unbound until the first send; don't cache the empty address
+      if (portOf(addr) == 0) {
+        record.local = addr;
+      } else {
+        bound = _boundAddresses.emplace(fd, addr).first;
+      }
+    }
+    if (bound != _boundAddresses.end()) {
+      record.local = bound->second;
+    }
+  }
+  _pendingBytes += charged;
+  _pending.push_back(std::move(record));
+  if (_pendingBytes >= WRITE_THRESHOLD) {
+    lock.unlock();
+    _cond.notify_one();
+  }
+}
+
+void PacketCapture::forget(int fd) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _boundAddresses.erase(fd);
+}
+
+CaptureStats PacketCapture::stats() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _stats;
+}
+
+void PacketCapture::run() {
+  std::vector<Record> batch;
+  std::string scratch;
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true) {
+    _cond.wait_for(lock, WRITE_INTERVAL, [this] {
+      return _stopped || _pendingBytes >= WRITE_THRESHOLD;
+    });
+    batch.swap(_pending);
+    _pendingBytes = 0;
+    auto stopping = _stopped;
+    lock.unlock();
+
+    uint64_t written = 0;
+    uint64_t bytes = 0;
+    bool failed = false;
+    for (const auto &record : batch) {
+      if (!failed && write(record, scratch)) {
+        written++;
+        bytes += record.size;
+      } else {
+        failed = true;
+      }
+    }
+    if (!failed && fflush(_file) != 0) {
+      failed = true;
+    }
+    auto lost = batch.size() - written;
+    batch.clear();
+
+    lock.lock();
+    _stats.packets += written;
+    _stats.bytes += bytes;
+    _stats.dropped += lost;
+    if (failed && !_failed) {
+      LOGW("Packet capture write failed: %s", error_name(errno).c_str());
+      _failed = true;
+    }
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+bool PacketCapture::write(const Record &record, std::string &scratch) {
+  auto inbound = record.direction == CaptureDirection::Inbound;
+  int family = record.remote.ss_family;
+  // A socket bound to the other family (or not bound yet) contributes an
+  // unspecified address and port 0
+  struct sockaddr_storage local;
+  memset(&local, 0, sizeof(local));
+  if (record.local.ss_family == family) {
+    local = record.local;
+  }
+
+  std::string packet;
+  packet.reserve(IPV6_HEADER + UDP_HEADER + record.payload.size());
+  appendHeaders(packet, family, inbound ? record.remote : local,
+                inbound ? local : record.remote, record.tos, record.size,
+                record.payload);
+  auto original = packet.size() + record.size;
+  packet += record.payload;
+
+  scratch.clear();
+  append<uint32_t>(scratch, ENHANCED_PACKET);
+  append<uint32_t>(scratch, 0); // Patched below
+  append<uint32_t>(scratch, 0); // Interface
+  append<uint32_t>(scratch, static_cast<uint32_t>(record.timestampUs >> 32));
+  append<uint32_t>(scratch, static_cast<uint32_t>(record.timestampUs));
+  append<uint32_t>(scratch, static_cast<uint32_t>(packet.size()));
+  append<uint32_t>(scratch, static_cast<uint32_t>(original));
+  scratch += packet;
+  pad(scratch);
+  append<uint16_t>(scratch, EPB_FLAGS);
+  append<uint16_t>(scratch, 4);
+  append<uint32_t>(scratch, inbound ? FLAG_INBOUND : FLAG_OUTBOUND);
+  append<uint32_t>(scratch, 0); // End of options
+  auto length = static_cast<uint32_t>(scratch.size() + 4);
+  memcpy(&scratch[4], &length, 4);
+  append<uint32_t>(scratch, length);
+
+  return fwrite(scratch.data(), 1, scratch.size(), _file) == scratch.size();
+}
+
+// Reader
+
+// Classic pcap magic numbers for microsecond and nanosecond timestamps
+constexpr uint32_t PCAP_MAGIC_US = 0xa1b2c3d4;
+constexpr uint32_t PCAP_MAGIC_NS = 0xa1b23c4d;
+
+constexpr uint16_t LINKTYPE_NULL = 0;
+constexpr uint16_t LINKTYPE_ETHERNET = 1;
+constexpr uint16_t LINKTYPE_LOOP = 108;
+constexpr uint16_t LINKTYPE_LINUX_SLL = 113;
+constexpr uint16_t LINKTYPE_IPV4 = 228;
+constexpr uint16_t LINKTYPE_IPV6 = 229;
+
+// Blocks larger than this are treated as corrupt
+constexpr uint32_t MAX_BLOCK = 16 * 1024 * 1024;
+
+static uint16_t swap16(uint16_t v) {
+  return static_cast<uint16_t>((v >> 8) | (v << 8));
+}
+
+static uint32_t swap32(uint32_t v) {
+  return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+uint16_t CaptureReader::u16(const char *p) const {
+  uint16_t v;
+  memcpy(&v, p, 2);
+  return _swapped ? swap16(v) : v;
+}
+
+uint32_t CaptureReader::u32(const char *p) const {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return _swapped ? swap32(v) : v;
+}
+
+// Strip the link-layer framing and IP / UDP headers off `frame`.
+static bool parseFrame(uint16_t linkType, const char *frame, size_t size,
+                       CapturedPacket &packet) {
+  auto *p = reinterpret_cast<const uint8_t *>(frame);
+  switch (linkType) {
+  case LINKTYPE_RAW:
+  case LINKTYPE_IPV4:
+  case LINKTYPE_IPV6:
+    break;
+  case LINKTYPE_NULL:
+  case LINKTYPE_LOOP:
+    // 4-byte address family in the writer's byte order; the IP version
+    // nibble below tells the families apart just as well
+    if (size < 4)
+      return false;
+    p += 4;
+    size -= 4;
+    break;
+  case LINKTYPE_ETHERNET: {
+    if (size < 14)
+      return false;
+    size_t offset = 12;
+    auto etherType = (p[offset] << 8) | p[offset + 1];
+    while (etherType == 0x8100 && size >= offset + 6) {
+      offset += 4; // 802.1Q tag
+      etherType = (p[offset] << 8) | p[offset + 1];
+    }
+    if (etherType != 0x0800 && etherType != 0x86dd)
+      return false;
+    p += offset + 2;
+    size -= offset + 2;
+    break;
+  }
+  case LINKTYPE_LINUX_SLL: {
+    if (size < 16)
+      return false;
+    auto protocol = (p[14] << 8) | p[15];
+    if (protocol != 0x0800 && protocol != 0x86dd)
+      return false;
+    p += 16;
+    size -= 16;
+    break;
+  }
+  default:
+    return false;
+  }
+
+  if (size < 1)
+    return false;
+  memset(&packet.source, 0, sizeof(packet.source));
+  memset(&packet.destination, 0, sizeof(packet.destination));
+  auto &src4 = reinterpret_cast<struct sockaddr_in &>(packet.source);
+  auto &dst4 = reinterpret_cast<struct sockaddr_in &>(packet.destination);
+  auto &src6 = reinterpret_cast<struct sockaddr_in6 &>(packet.source);
+  auto &dst6 = reinterpret_cast<struct sockaddr_in6 &>(packet.destination);
+  size_t headerLength;
+  auto version = p[0] >> 4;
+  if (version == 4) {
+    headerLength = (p[0] & 0x0f) * 4;
+    auto fragment = ((p[6] & 0x3f) << 8) | p[7];
+    if (size < IPV4_HEADER || headerLength < IPV4_HEADER ||
+        p[9] != IPPROTO_UDP || fragment != 0)
+      return false;
+    src4.sin_family = dst4.sin_family = AF_INET;
+    memcpy(&src4.sin_addr, p + 12, 4);
+    memcpy(&dst4.sin_addr, p + 16, 4);
+  } else if (version == 6) {
+    // Extension headers are not followed
+    headerLength = IPV6_HEADER;
+    if (size < IPV6_HEADER || p[6] != IPPROTO_UDP)
+      return false;
+    src6.sin6_family = dst6.sin6_family = AF_INET6;
+    memcpy(&src6.sin6_addr, p + 8, 16);
+    memcpy(&dst6.sin6_addr, p + 24, 16);
+  } else {
+    return false;
+  }
+  if (size < headerLength + UDP_HEADER)
+    return false;
+
+  auto *udp = p + headerLength;
+  uint16_t srcPort, dstPort;
+  memcpy(&srcPort, udp, 2);
+  memcpy(&dstPort, udp + 2, 2);
+  if (version == 4) {
+    src4.sin_port = srcPort;
+    dst4.sin_port = dstPort;
+  } else {
+    src6.sin6_port = srcPort;
+    dst6.sin6_port = dstPort;
+  }
+  size_t udpLength = (udp[4] << 8) | udp[5];
+  if (udpLength < UDP_HEADER)
+    return false;
+  auto available = size - headerLength - UDP_HEADER;
+  auto length = std::min(udpLength - UDP_HEADER, available);
+  packet.payload.assign(reinterpret_cast<const char *>(udp + UDP_HEADER),
+                        length);
+  return true;
+}
+
+CaptureReader::CaptureReader(const std::string &path)
+    : _file(fopen(path.c_str(), "rb")) {
+  if (!_file) {
+    throw UdpError(error_name(errno));
+  }
+  uint32_t magic = 0;
+  if (fread(&magic, 1, 4, _file) != 4) {
+    fclose(_file);
+    throw UdpError("E_INVALID_CAPTURE");
+  }
+  if (magic == SECTION_HEADER) {
+    _pcapng = true;
+    rewind(_file);
+    uint32_t type;
+    std::string body;
+    if (readBlock(type, body) && type == SECTION_HEADER &&
+        readSectionHeader(body)) {
+      return;
+    }
+  } else if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS ||
+             swap32(magic) == PCAP_MAGIC_US ||
+             swap32(magic) == PCAP_MAGIC_NS) {
+    _swapped = magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS;
+    char header[20];
+    if (fread(header, 1, sizeof(header), _file) == sizeof(header)) {
+      auto nanoseconds = (_swapped ? swap32(magic) : magic) == PCAP_MAGIC_NS;
+      _interfaces.push_back({static_cast<uint16_t>(u32(header + 16)),
+                             nanoseconds ? 1000000000ull : 1000000ull});
+      return;
+    }
+  }
+  fclose(_file);
+  throw UdpError("E_INVALID_CAPTURE");
+}
+
+CaptureReader::~CaptureReader() { fclose(_file); }
+
+// Read one pcapng block; `body` excludes the type and both lengths.
+bool CaptureReader::readBlock(uint32_t &type, std::string &body) {
+  char head[8];
+  if (fread(head, 1, sizeof(head), _file) != sizeof(head)) {
+    return false;
+  }
+  memcpy(&type, head, 4);
+  if (type == SECTION_HEADER) {
+    // Byte order is only known once the section header's magic is read
+    char magic[4];
+    if (fread(magic, 1, 4, _file) != 4) {
+      return false;
+    }
+    uint32_t order;
+    memcpy(&order, magic, 4);
+    _swapped = order != BYTE_ORDER_MAGIC;
+    if (fseek(_file, -4, SEEK_CUR) != 0) {
+      return false;
+    }
+  } else {
+    type = u32(head);
+  }
+  auto length = u32(head + 4);
+  if (length < 12 || length % 4 != 0 || length > MAX_BLOCK) {
+    return false;
+  }
+  body.resize(length - 12);
+  char trailer[4];
+  return fread(&body[0], 1, body.size(), _file) == body.size() &&
+         fread(trailer, 1, 4, _file) == 4;
+}
+
+bool CaptureReader::readSectionHeader(const std::string &body) {
+  if (body.size() < 16 || u32(body.data()) != BYTE_ORDER_MAGIC) {
+    return false;
+  }
+  _interfaces.clear();
+  return true;
+}
+
+bool CaptureReader::next(CapturedPacket &packet) {
+  return _pcapng ? nextPcapng(packet) : nextClassic(packet);
+}
+
+bool CaptureReader::nextClassic(CapturedPacket &packet) {
+  char header[16];
+  std::string frame;
+  while (fread(header, 1, sizeof(header), _file) == sizeof(header)) {
+    auto captured = u32(header + 8);
+    if (captured > MAX_BLOCK) {
+      return false;
+    }
+    frame.resize(captured);
+    if (fread(&frame[0], 1, captured, _file) != captured) {
+      return false;
+    }
+    auto &iface = _interfaces.front();
+    packet.timestampUs =
+        uint64_t(u32(header)) * 1000000 +
+        uint64_t(u32(header + 4)) * 1000000 / iface.resolution;
+    packet.direction.reset();
+    if (parseFrame(iface.linkType, frame.data(), frame.size(), packet)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CaptureReader::nextPcapng(CapturedPacket &packet) {
+  uint32_t type;
+  std::string body;
+  while (readBlock(type, body)) {
+    if (type == SECTION_HEADER) {
+      if (!readSectionHeader(body)) {
+        return false;
+      }
+    } else if (type == INTERFACE_DESCRIPTION && body.size() >= 8) {
+      Interface iface{u16(body.data()), 1000000};
+      // Look for if_tsresol among the options
+      for (size_t offset = 8; offset + 4 <= body.size();) {
+        auto code = u16(body.data() + offset);
+        auto length = u16(body.data() + offset + 2);
+        if (code == 0 || offset + 4 + length > body.size())
+          break;
+        if (code == 9 && length >= 1) {
+          auto exponent = static_cast<uint8_t>(body[offset + 4]);
+          uint64_t base = exponent & 0x80 ? 2 : 10;
+          iface.resolution = 1;
+          for (int i = 0; i < (exponent & 0x7f) && i < 19; i++) {
+            iface.resolution *= base;
+          }
+        }
+        offset += 4 + ((length + 3) & ~3u);
+      }
+      _interfaces.push_back(iface);
+    } else if (type == ENHANCED_PACKET && body.size() >= 20) {
+      auto id = u32(body.data());
+      auto captured = u32(body.data() + 12);
+      if (id >= _interfaces.size() || 20 + size_t(captured) > body.size()) {
+        continue;
+      }
+      auto &iface = _interfaces[id];
+      auto raw = (uint64_t(u32(body.data() + 4)) << 32) | u32(body.data() + 8);
+      packet.timestampUs =
+          iface.resolution == 1000000
+              ? raw
+              : static_cast<uint64_t>(raw * (1e6 / iface.resolution));
+      packet.direction.reset();
+      for (size_t offset = 20 + ((captured + 3) & ~3u);
+           offset + 4 <= body.size();) {
+        auto code = u16(body.data() + offset);
+        auto length = u16(body.data() + offset + 2);
+        if (code == 0 || offset + 4 + length > body.size())
+          break;
+        if (code == EPB_FLAGS && length == 4) {
+          auto flags = u32(body.data() + offset + 4) & 3;
+          if (flags == FLAG_INBOUND) {
+            packet.direction = CaptureDirection::Inbound;
+          } else if (flags == FLAG_OUTBOUND) {
+            packet.direction = CaptureDirection::Outbound;
+          }
+        }
+        offset += 4 + ((length + 3) & ~3u);
+      }
+      if (parseFrame(iface.linkType, body.data() + 20, captured,
+                     packet)) {
+        return true;
+      }
+    }
+    // Other blocks (simple packets have no timestamps) are skipped
+  }
+  return false;
+}
+
+ReplayStats replayCapture(UdpCore &core, int id, int type,
+                          const std::string &path, const std::string &host,
+                          int port, const ReplayOptions &options) {
+  CaptureReader reader(path);
+  ReplayStats stats;
+  CapturedPacket packet;
+  std::optional<uint64_t> firstUs;
+  auto start = std::chrono::steady_clock::now();
+
+  while (reader.next(packet)) {
+    if ((options.direction && packet.direction &&
+         *packet.direction != *options.direction) ||
+        (options.port != 0 &&
+         ntohs(static_cast<uint16_t>(portOf(packet.destination))) !=
+             options.port)) {
+      stats.skipped++;
+      continue;
+    }
+    if (!firstUs) {
+      firstUs = packet.timestampUs;
+    }
+    if (options.speed > 0 && packet.timestampUs > *firstUs) {
+      auto offsetUs = (packet.timestampUs - *firstUs) / options.speed;
+      std::this_thread::sleep_until(
+          start + std::chrono::microseconds(static_cast<int64_t>(offsetUs)));
+    }
+    try {
+      core.send(id, type, host, port, packet.payload.data(),
+                packet.payload.size());
+      stats.sent++;
+    } catch (const UdpError &) {
+      stats.failed++;
+    }
+  }
+  stats.seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+  return stats;
+}
+
+} // namespace jsiudp
@@ -0,0 +1,132 @@
+#pragma once
+#include "udp-core.h"
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace jsiudp {
+
+// pcapng writer for UdpCore's capture hook. Datagrams are stored with
+// synthesized IPv4 / IPv6 + UDP headers (LINKTYPE_RAW) so standard tools can
+// decode them, and each packet's flags carry its direction. record() only
+// copies the datagram into a buffer; encoding and file I/O happen on the
+// writer thread.
+class PacketCapture {
+public:
+  // Creates / truncates `path`; throws UdpError if it can't be opened.
+  PacketCapture(const std::string &path, const CaptureConfig &config);
+  ~PacketCapture();
+
+  // Write whatever is buffered and stop the writer; later records are
+  // ignored.
+  void finish();
+
+  // `local` with family 0 is filled in from the socket's bound address.
+  void record(CaptureDirection direction, int fd,
+              const struct sockaddr_storage &remote,
+              const struct sockaddr_storage &local, int tos,
+              const void *data, size_t size);
+  // Drop the cached bound address of a socket that is closing
+  void forget(int fd);
+  CaptureStats stats();
+
+private:
+  struct Record {
+    uint64_t timestampUs;
+    CaptureDirection direction;
+    struct sockaddr_storage remote;
+    struct sockaddr_storage local;
+    int tos;
+    size_t size;
+    std::string payload;
+  };
+
+  void run();
+  bool write(const Record &record, std::string &scratch);
+
+  CaptureConfig _config;
+  FILE *_file;
+  std::thread _thread;
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::vector<Record> _pending;
+  size_t _pendingBytes = 0;
+  bool _stopped = false;
+  bool _failed = false;
+  CaptureStats _stats;
+  std::map<int, struct sockaddr_storage> _boundAddresses;
+};
+
+// A UDP datagram read back from a capture.
+struct CapturedPacket {
+  uint64_t timestampUs = 0;
+  // Unset for files without direction flags (e.g. from tcpdump)
+  std::optional<CaptureDirection> direction;
+  struct sockaddr_storage source;
+  struct sockaddr_storage destination;
+  // Shorter than the original datagram if the capture truncated it
+  std::string payload;
+};
+
+// Reads UDP datagrams from pcapng or classic pcap files with raw IP,
+// Ethernet, Linux cooked or BSD loopback framing; anything else is skipped.
+class CaptureReader {
+public:
+  // Throws UdpError if the file can't be opened or isn't a capture.
+  explicit CaptureReader(const std::string &path);
+  ~CaptureReader();
+
+  // False at the end of the file (or at the first malformed block).
+  bool next(CapturedPacket &packet);
+
+private:
+  struct Interface {
+    uint16_t linkType;
+    // Timestamp units per second
+    uint64_t resolution;
+  };
+
+  bool readBlock(uint32_t &type, std::string &body);
+  bool readSectionHeader(const std::string &body);
+  bool nextClassic(CapturedPacket &packet);
+  bool nextPcapng(CapturedPacket &packet);
+  uint16_t u16(const char *p) const;
+  uint32_t u32(const char *p) const;
+
+  FILE *_file;
+  bool _pcapng = false;
+  bool _swapped = false;
+  std::vector<Interface> _interfaces;
+};
+
+struct ReplayOptions {
+  // 1 replays at the captured pace, 2 twice as fast; 0 sends back to back
+  double speed = 1;
+  // Only datagrams recorded in this direction; datagrams without one are
+  // always replayed. Unset replays both.
+  std::optional<CaptureDirection> direction = CaptureDirection::Inbound;
+  // Only datagrams whose destination port is this, 0 for any
+  int port = 0;
+};
+
+struct ReplayStats {
+  uint64_t sent = 0;
+  uint64_t skipped = 0;
+  // send() threw, e.g. a full AF_UNIX queue
+  uint64_t failed = 0;
+  double seconds = 0;
+};
+
+// Re-send the payloads of a capture from socket `id` to host:port, keeping
+// the captured gaps between datagrams (scaled by `speed`). Blocks until the
+// capture is exhausted.
+ReplayStats replayCapture(UdpCore &core, int id, int type,
+                          const std::string &path, const std::string &host,
+                          int port, const ReplayOptions &options);
+
+} // namespace jsiudp
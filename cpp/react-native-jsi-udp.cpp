@@ -1,447 +1,390 @@
 #include "react-native-jsi-udp.h"
 #include "helper.h"
+#include "trace.h"
+#include <algorithm>
 #include <arpa/inet.h>
+#include <atomic>
+#include <cstring>
+#include <iterator>
 #include <jsi/jsi.h>
-#include <map>
+#include <limits>
 #include <memory>
-#include <mutex>
 #include <netinet/in.h>
-#include <poll.h>
-#include <queue>
 #include <string>
-#include <sys/errno.h>
-#include <sys/fcntl.h>
 #include <sys/socket.h>
-#include <sys/types.h>
-#include <thread>
-#include <unistd.h>
-#include <vector>
-
-#if __APPLE__
-
-#import <ifaddrs.h>
-#include <net/if.h>
-
-#endif
-
-#ifndef IPV6_ADD_MEMBERSHIP
-#define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
-#define IPV6_DROP_MEMBERSHIP IPV6_LEAVE_GROUP
-#endif
-
-#define MAX_PACK_SIZE 65535
 
 using namespace facebook::jsi;
 using namespace facebook::react;
 
 namespace jsiudp {
 
-std::string error_name(int err) {
-  switch (err) {
-  case EACCES:
-    return "EACCES";
-  case EADDRINUSE:
-    return "EADDRINUSE";
-  case EADDRNOTAVAIL:
-    return "EADDRNOTAVAIL";
-  case EAFNOSUPPORT:
-    return "EAFNOSUPPORT";
-  case EAGAIN:
-    return "EAGAIN";
-  case EALREADY:
-    return "EALREADY";
-  case EBADF:
-    return "EBADF";
-  case ECONNREFUSED:
-    return "ECONNREFUSED";
-  case EFAULT:
-    return "EFAULT";
-  case EINPROGRESS:
-    return "EINPROGRESS";
-  case EINTR:
-    return "EINTR";
-  case EISCONN:
-    return "EISCONN";
-  case ENETUNREACH:
-    return "ENETUNREACH";
-  case ENOTSOCK:
-    return "ENOTSOCK";
-  case ETIMEDOUT:
-    return "ETIMEDOUT";
-  case ENOPROTOOPT:
-    return "ENOPROTOOPT";
-  case EINVAL:
-    return "EINVAL";
-  case EDOM:
-    return "EDOM";
-  case ENOMEM:
-    return "ENOMEM";
-  case ENOBUFS:
-    return "ENOBUFS";
-  case EOPNOTSUPP:
-    return "EOPNOTSUPP";
-  case ENETDOWN:
-    return "ENETDOWN";
-  case ECONNABORTED:
-    return "ECONNABORTED";
-  case ECONNRESET:
-    return "ECONNRESET";
-  case ENOTCONN:
-    return "ENOTCONN";
-  case EHOSTUNREACH:
-    return "EHOSTUNREACH";
-  case EPERM:
-    return "EPERM";
-  case EPIPE:
-    return "EPIPE";
-  default:
-    LOGE("unknown error %d", err);
-    return "UNKNOWN";
-  }
-}
-
-int setupIface(int fd, struct sockaddr_in &addr) {
-#if __APPLE__
-  struct ifaddrs *ifaddr, *ifa;
-  if (getifaddrs(&ifaddr) == -1) {
-    return -1;
-  }
-  auto isAny = addr.sin_addr.s_addr == INADDR_ANY;
-  auto isLoopback = addr.sin_addr.s_addr == htonl(INADDR_LOOPBACK);
-  for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
-    if (ifa->ifa_addr != NULL && ifa->ifa_addr->sa_family == AF_INET &&
-        !((ifa->ifa_flags & IFF_LOOPBACK) ^ isLoopback) &&
-        (ifa->ifa_flags & IFF_UP) && (ifa->ifa_flags & IFF_RUNNING) &&
-        (isAny || reinterpret_cast<struct sockaddr_in *>(ifa->ifa_addr)
-                          ->sin_addr.s_addr == addr.sin_addr.s_addr)) {
-      auto index = if_nametoindex(ifa->ifa_name);
-      if (setsockopt(fd, IPPROTO_IP, IP_BOUND_IF, &index, sizeof(index)) != 0) {
-        return -1;
-      }
-      LOGI("bound to %s for %d", ifa->ifa_name, fd);
-      break;
-    }
+// Rethrow core errors as JS errors carrying the same code.
+template <typename F>
+static auto callCore(Runtime &runtime, F &&f) -> decltype(f()) {
+  try {
+    return f();
+  } catch (const UdpError &e) {
+    throw JSError(runtime, e.what());
   }
-  freeifaddrs(ifaddr);
-#endif
-  return 0;
-}
-
-int setupIface(int fd, struct sockaddr_in6 &addr) {
-#if __APPLE__
-  struct ifaddrs *ifaddr, *ifa;
-  if (getifaddrs(&ifaddr) == -1) {
-    return -1;
-  }
-  auto size = sizeof(addr);
-  auto isAny = memcmp(&(addr.sin6_addr), &in6addr_any, size) == 0;
-  auto isLoopback = memcmp(&(addr.sin6_addr), &in6addr_loopback, size) == 0;
-  for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
-    if (ifa->ifa_addr != NULL && ifa->ifa_addr->sa_family == AF_INET6 &&
-        !((ifa->ifa_flags & IFF_LOOPBACK) ^ isLoopback) &&
-        (ifa->ifa_flags & IFF_UP) && (ifa->ifa_flags & IFF_RUNNING) &&
-        (isAny ||
-         memcmp(&(addr.sin6_addr),
-                &(reinterpret_cast<struct sockaddr_in6 *>(ifa->ifa_addr)
-                      ->sin6_addr),
-                size) == 0)) {
-      auto index = if_nametoindex(ifa->ifa_name);
-      if (setsockopt(fd, IPPROTO_IPV6, IPV6_BOUND_IF, &index, sizeof(index)) !=
-          0) {
-        return -1;
-      }
-      LOGI("bound to %s for %d", ifa->ifa_name, fd);
-      break;
-    }
+}
+
+// Upper bound for options cast to size_t, which is 32 bits on some ABIs
+static constexpr double MAX_UINT32 = std::numeric_limits<uint32_t>::max();
+
+// A JS number within [min, max], or `fallback` if the value isn't a number.
+// Callers cast the result, which is undefined out of range, so anything else
+// (NaN included) throws EINVAL; a NaN fallback makes the value required.
+static double checkedNumber(Runtime &runtime, const Value &value,
+                            double fallback, double min, double max) {
+  auto result = value.isNumber() ? value.asNumber() : fallback;
+  if (!(result >= min && result <= max)) {
+    throw JSError(runtime, "EINVAL");
   }
-  freeifaddrs(ifaddr);
-#endif
-  return 0;
+  return result;
 }
 
-UdpManager::UdpManager(Runtime *jsiRuntime,
-                       std::shared_ptr<CallInvoker> callInvoker)
-    : _runtime(jsiRuntime), _callInvoker(callInvoker) {
-  // Create self-pipe for waking the poll thread
-  if (pipe(_wakePipe) != 0) {
-    LOGE("Failed to create wake pipe: %s", error_name(errno).c_str());
-  } else {
-    // Set read end to non-blocking for draining
-    fcntl(_wakePipe[0], F_SETFL, fcntl(_wakePipe[0], F_GETFL) | O_NONBLOCK);
-  }
-
-  eventThread = std::thread(&UdpManager::receiveEvent, this);
-  _pollThread = std::thread(&UdpManager::pollLoop, this);
-
-  EXPOSE_FN(*_runtime, datagram_create, 1, BIND_METHOD(UdpManager::create));
-  EXPOSE_FN(*_runtime, datagram_bind, 4, BIND_METHOD(UdpManager::bind));
-  EXPOSE_FN(*_runtime, datagram_send, 5, BIND_METHOD(UdpManager::send));
-  EXPOSE_FN(*_runtime, datagram_close, 1, BIND_METHOD(UdpManager::close));
-  EXPOSE_FN(*_runtime, datagram_getOpt, 3, BIND_METHOD(UdpManager::getOpt));
-  EXPOSE_FN(*_runtime, datagram_setOpt, 5, BIND_METHOD(UdpManager::setOpt));
-  EXPOSE_FN(*_runtime, datagram_getSockName, 2,
-            BIND_METHOD(UdpManager::getSockName));
+static double checkedNumber(Runtime &runtime, const Object &object,
+                            const char *name, double fallback, double min,
+                            double max) {
+  return checkedNumber(runtime, object.getProperty(runtime, name), fallback,
+                       min, max);
+}
 
-  auto global = _runtime->global();
-  global.setProperty(*_runtime, "dgc_SOL_SOCKET", static_cast<int>(SOL_SOCKET));
-  global.setProperty(*_runtime, "dgc_IPPROTO_IP", static_cast<int>(IPPROTO_IP));
-  global.setProperty(*_runtime, "dgc_IPPROTO_IPV6",
-                     static_cast<int>(IPPROTO_IPV6));
-  global.setProperty(*_runtime, "dgc_SO_REUSEADDR",
-                     static_cast<int>(SO_REUSEADDR));
-  global.setProperty(*_runtime, "dgc_SO_REUSEPORT",
-                     static_cast<int>(SO_REUSEPORT));
-  global.setProperty(*_runtime, "dgc_SO_BROADCAST",
-                     static_cast<int>(SO_BROADCAST));
-  global.setProperty(*_runtime, "dgc_SO_RCVBUF", static_cast<int>(SO_RCVBUF));
-  global.setProperty(*_runtime, "dgc_SO_SNDBUF", static_cast<int>(SO_SNDBUF));
-  global.setProperty(*_runtime, "dgc_IP_MULTICAST_TTL",
-                     static_cast<int>(IP_MULTICAST_TTL));
-  global.setProperty(*_runtime, "dgc_IP_MULTICAST_LOOP",
-                     static_cast<int>(IP_MULTICAST_LOOP));
-  global.setProperty(*_runtime, "dgc_IP_ADD_MEMBERSHIP",
-                     static_cast<int>(IP_ADD_MEMBERSHIP));
-  global.setProperty(*_runtime, "dgc_IP_DROP_MEMBERSHIP",
-                     static_cast<int>(IP_DROP_MEMBERSHIP));
-  global.setProperty(*_runtime, "dgc_IP_TTL", static_cast<int>(IP_TTL));
-  global.setProperty(*_runtime, "datagram_callbacks", Object(*_runtime));
+static const char *familyName(int family) {
+  return family == AF_INET    ? "IPv4"
+         : family == AF_INET6 ? "IPv6"
+                              : "unix";
 }
 
-UdpManager::~UdpManager() {
-  _invalidate = true;
-  wakePoller();
-  cond.notify_all();
-  if (_pollThread.joinable())
-    _pollThread.join();
-  if (eventThread.joinable())
-    eventThread.join();
-  if (_wakePipe[0] >= 0)
-    ::close(_wakePipe[0]);
-  if (_wakePipe[1] >= 0)
-    ::close(_wakePipe[1]);
-  for (const auto &[id, fd] : idToFdMap) {
-    ::close(fd);
-  }
-}
-
-void UdpManager::watchFd(int fd) {
-  if (_invalidate)
-    return;
-  {
-    std::lock_guard<std::mutex> lock(_watchMutex);
-    _watchedFds.insert(fd);
+// In RemoteInfoStrings::Prop order
+static const char *const REMOTE_INFO_PROPS[] = {
+    "address",        "family", "port", "size", "localAddress",
+    "interfaceIndex", "tos",    "dscp", "ecn"};
+static_assert(std::size(REMOTE_INFO_PROPS) == RemoteInfoStrings::PROP_COUNT);
+
+RemoteInfoStrings::RemoteInfoStrings(Runtime &runtime) {
+  _names.reserve(PROP_COUNT);
+  for (auto prop : REMOTE_INFO_PROPS) {
+    _names.push_back(PropNameID::forAscii(runtime, prop));
   }
-  wakePoller();
 }
 
-void UdpManager::unwatchFd(int fd) {
-  {
-    std::lock_guard<std::mutex> lock(_watchMutex);
-    _watchedFds.erase(fd);
+std::optional<RemoteInfoStrings::Prop>
+RemoteInfoStrings::find(Runtime &runtime, const PropNameID &name) const {
+  for (size_t i = 0; i < _names.size(); i++) {
+    if (PropNameID::compare(runtime, name, _names[i])) {
+      return static_cast<Prop>(i);
+    }
   }
-  wakePoller();
+  return std::nullopt;
 }
 
-void UdpManager::wakePoller() {
-  char c = 1;
-  // Best-effort write; if pipe is full the poller will wake anyway
-  auto unused __attribute__((unused)) = write(_wakePipe[1], &c, 1);
+Value RemoteInfoStrings::address(Runtime &runtime, AddressCache &cache,
+                                 const struct sockaddr_storage &addr) {
+  auto host = cache.lookup(addr);
+  auto it = _addresses.find(host);
+  if (it == _addresses.end()) {
+    if (_addresses.size() >= MAX_ADDRESSES) {
+      _addresses.clear();
+    }
+    // Unix paths may be any UTF-8; formatted IPs are ASCII
+    auto string = addr.ss_family == AF_UNIX
+                      ? String::createFromUtf8(runtime, host)
+                      : String::createFromAscii(runtime, host);
+    it = _addresses.emplace(std::move(host), std::move(string)).first;
+  }
+  return Value(runtime, it->second);
 }
 
-void UdpManager::pollLoop() {
-  char buffer[MAX_PACK_SIZE];
+bool RemoteInfo::has(RemoteInfoStrings::Prop prop) const {
+  switch (prop) {
+  case RemoteInfoStrings::LOCAL_ADDRESS:
+  case RemoteInfoStrings::INTERFACE_INDEX:
+    return _local.ss_family != 0;
+  case RemoteInfoStrings::TOS:
+  case RemoteInfoStrings::DSCP:
+  case RemoteInfoStrings::ECN:
+    return _tos >= 0;
+  default:
+    return prop != RemoteInfoStrings::PROP_COUNT;
+  }
+}
 
-  while (!_invalidate) {
-    // Build pollfd array: wake pipe + all watched socket fds
-    std::vector<struct pollfd> pollfds;
-    {
-      std::lock_guard<std::mutex> lock(_watchMutex);
-      pollfds.reserve(_watchedFds.size() + 1);
-      pollfds.push_back({_wakePipe[0], POLLIN, 0});
-      for (int fd : _watchedFds) {
-        pollfds.push_back({fd, POLLIN, 0});
-      }
-    }
+Value RemoteInfo::value(Runtime &runtime, RemoteInfoStrings::Prop prop) {
+  if (!has(prop)) {
+    return Value::undefined();
+  }
+  switch (prop) {
+  case RemoteInfoStrings::ADDRESS:
+    return _strings->address(runtime, *_cache, _addr);
+  case RemoteInfoStrings::FAMILY:
+    return String::createFromAscii(runtime, familyName(_addr.ss_family));
+  case RemoteInfoStrings::PORT:
+    return addressPort(_addr);
+  case RemoteInfoStrings::SIZE:
+    return static_cast<int>(_size);
+  case RemoteInfoStrings::LOCAL_ADDRESS:
+    return _strings->address(runtime, *_cache, _local);
+  case RemoteInfoStrings::INTERFACE_INDEX:
+    return static_cast<int>(_ifindex);
+  case RemoteInfoStrings::TOS:
+    return _tos;
+  case RemoteInfoStrings::DSCP:
+    return _tos >> 2;
+  case RemoteInfoStrings::ECN:
+    return _tos & 0x3;
+  case RemoteInfoStrings::PROP_COUNT:
+    break;
+  }
+  return Value::undefined();
+}
 
-    int ret = poll(pollfds.data(), static_cast<nfds_t>(pollfds.size()), -1);
-    if (ret < 0) {
-      if (errno == EINTR)
-        continue;
-      LOGE("poll error: %s", error_name(errno).c_str());
-      break;
+Value RemoteInfo::get(Runtime &runtime, const PropNameID &name) {
+  if (!_assigned.empty()) {
+    auto it = _assigned.find(name.utf8(runtime));
+    if (it != _assigned.end()) {
+      return Value(runtime, it->second);
     }
-    if (_invalidate)
-      break;
+  }
+  auto prop = _strings->find(runtime, name);
+  return prop ? value(runtime, *prop) : Value::undefined();
+}
 
-    // Drain wake pipe if signaled
-    if (pollfds[0].revents & POLLIN) {
-      char dummy[64];
-      while (read(_wakePipe[0], dummy, sizeof(dummy)) > 0) {
-      }
-      // fd set may have changed, will be rebuilt next iteration
-    }
+// Assignment behaves as on a plain object; rinfo used to be one.
+void RemoteInfo::set(Runtime &runtime, const PropNameID &name,
+                     const Value &value) {
+  _assigned.insert_or_assign(name.utf8(runtime), Value(runtime, value));
+}
 
-    // Process socket fds that have data ready
-    for (size_t i = 1; i < pollfds.size(); i++) {
-      if (pollfds[i].revents & POLLNVAL)
-        continue; // fd was closed, skip
-      if (!(pollfds[i].revents & POLLIN))
-        continue;
-
-      int fd = pollfds[i].fd;
-
-      // Read all available datagrams from this fd
-      while (!_invalidate) {
-        struct sockaddr_storage src_addr;
-        socklen_t src_len = sizeof(src_addr);
-        auto recvn =
-            recvfrom(fd, buffer, sizeof(buffer), MSG_DONTWAIT,
-                     reinterpret_cast<struct sockaddr *>(&src_addr), &src_len);
-        if (recvn < 0) {
-          if (errno == EAGAIN || errno == EWOULDBLOCK)
-            break; // No more data
-          if (errno == EBADF)
-            break; // Socket was closed
-          sendEvent({fd, ERROR, error_name(errno), 0, "", 0});
-          break;
-        }
-
-        // Extract address based on actual family
-        if (src_addr.ss_family == AF_INET) {
-          auto *addr4 = reinterpret_cast<struct sockaddr_in *>(&src_addr);
-          sendEvent({fd, MESSAGE, std::string(buffer, recvn), AF_INET,
-                     inet_ntoa(addr4->sin_addr), ntohs(addr4->sin_port)});
-        } else {
-          auto *addr6 = reinterpret_cast<struct sockaddr_in6 *>(&src_addr);
-          char host[INET6_ADDRSTRLEN];
-          inet_ntop(AF_INET6, &addr6->sin6_addr, host, INET6_ADDRSTRLEN);
-          sendEvent({fd, MESSAGE, std::string(buffer, recvn), AF_INET6, host,
-                     ntohs(addr6->sin6_port)});
-        }
-      }
+std::vector<PropNameID> RemoteInfo::getPropertyNames(Runtime &runtime) {
+  std::vector<PropNameID> names;
+  for (size_t i = 0; i < RemoteInfoStrings::PROP_COUNT; i++) {
+    auto prop = static_cast<RemoteInfoStrings::Prop>(i);
+    if (has(prop) || _assigned.count(REMOTE_INFO_PROPS[i]) != 0) {
+      names.push_back(PropNameID(runtime, _strings->name(prop)));
     }
   }
+  for (const auto &[name, value] : _assigned) {
+    if (std::find(std::begin(REMOTE_INFO_PROPS), std::end(REMOTE_INFO_PROPS),
+                  name) == std::end(REMOTE_INFO_PROPS)) {
+      names.push_back(PropNameID::forUtf8(runtime, name));
+    }
+  }
+  return names;
 }
 
-int UdpManager::getFdOrThrow(Runtime &runtime, int id) {
-  std::lock_guard<std::mutex> lock(mutex);
-  auto it = idToFdMap.find(id);
-  if (it == idToFdMap.end()) {
-    throw JSError(runtime, "EBADF");
+Object RemoteInfo::toObject(Runtime &runtime) {
+  auto result = Object(runtime);
+  for (size_t i = 0; i < RemoteInfoStrings::PROP_COUNT; i++) {
+    auto prop = static_cast<RemoteInfoStrings::Prop>(i);
+    if (has(prop)) {
+      result.setProperty(runtime, _strings->name(prop), value(runtime, prop));
+    }
   }
-  return it->second;
+  return result;
 }
 
-void UdpManager::closeAll() {
-  std::map<int, int> snapshot;
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    snapshot = idToFdMap;
-    idToFdMap.clear();
-    suspendedSockets.clear();
-  }
+// The manager of the main runtime, for secondary runtimes to install on
+static std::mutex currentMutex;
+static std::weak_ptr<UdpManager> currentManager;
+
+std::shared_ptr<UdpManager>
+UdpManager::make(Runtime *jsiRuntime,
+                 std::shared_ptr<CallInvoker> callInvoker) {
+  auto manager = std::make_shared<UdpManager>(jsiRuntime, callInvoker);
+  // Host functions bind weak_from_this(), which needs the owning pointer
+  manager->install(jsiRuntime, std::move(callInvoker));
+  std::lock_guard<std::mutex> lock(currentMutex);
+  currentManager = manager;
+  return manager;
+}
 
+UdpManager::UdpManager(Runtime *jsiRuntime,
+                       std::shared_ptr<CallInvoker> callInvoker)
+    : _runtime(jsiRuntime), _callInvoker(callInvoker),
+      _addressCache(std::make_shared<AddressCache>()) {
+  // Batches go from the I/O thread straight to the call invokers
+  _core = std::make_unique<UdpCore>(
+      [this](EventBatch &&batch) { _router.dispatchBatch(std::move(batch)); },
+      DispatchMode::Direct);
+}
+
+UdpManager::~UdpManager() {
+  // Stop the core threads before the members they call back into go away
+  _core.reset();
+}
+
+bool UdpManager::installRuntime(Runtime *runtime,
+                                std::shared_ptr<CallInvoker> callInvoker) {
+  std::shared_ptr<UdpManager> manager;
   {
-    std::lock_guard<std::mutex> lock(_watchMutex);
-    _watchedFds.clear();
+    std::lock_guard<std::mutex> lock(currentMutex);
+    manager = currentManager.lock();
   }
-  wakePoller();
-
-  for (const auto &[id, fd] : snapshot) {
-    ::close(fd);
+  if (!manager) {
+    return false;
   }
+  manager->install(runtime, std::move(callInvoker));
+  return true;
 }
 
-void UdpManager::runOnJS(std::function<void()> &&f) {
-  if (_callInvoker) {
-    _callInvoker->invokeAsync(std::move(f));
+bool UdpManager::uninstallRuntime(Runtime *runtime) {
+  std::shared_ptr<UdpManager> manager;
+  {
+    std::lock_guard<std::mutex> lock(currentMutex);
+    manager = currentManager.lock();
+  }
+  if (!manager) {
+    return false;
   }
+  manager->uninstall(runtime);
+  return true;
 }
 
-JSI_HOST_FUNCTION(UdpManager::create) {
-  auto type = static_cast<int>(arguments[0].asNumber());
+void UdpManager::install(Runtime *runtime,
+                         std::shared_ptr<CallInvoker> callInvoker) {
+  auto strings = std::make_shared<RemoteInfoStrings>(*runtime);
+  {
+    std::lock_guard<std::mutex> lock(_targetsMutex);
+    _targets[runtime] = std::make_shared<RuntimeTarget>(
+        runtime, std::move(callInvoker), _addressCache, strings,
+        _core->consumer());
+  }
+
+  EXPOSE_FN(*runtime, datagram_create, 1, BIND_METHOD(UdpManager::create));
+  EXPOSE_FN(*runtime, datagram_bind, 4, BIND_METHOD(UdpManager::bind));
+  EXPOSE_FN(*runtime, datagram_send, 6, BIND_METHOD(UdpManager::send));
+  EXPOSE_FN(*runtime, datagram_sendRequest, 6,
+            BIND_METHOD(UdpManager::sendRequest));
+  EXPOSE_FN(*runtime, datagram_close, 1, BIND_METHOD(UdpManager::close));
+  EXPOSE_FN(*runtime, datagram_getOpt, 3, BIND_METHOD(UdpManager::getOpt));
+  EXPOSE_FN(*runtime, datagram_setOpt, 5, BIND_METHOD(UdpManager::setOpt));
+  EXPOSE_FN(*runtime, datagram_getSockName, 2,
+            BIND_METHOD(UdpManager::getSockName));
+  EXPOSE_FN(*runtime, datagram_setSuspendMode, 2,
+            BIND_METHOD(UdpManager::setSuspendMode));
+  EXPOSE_FN(*runtime, datagram_setPollerOptions, 1,
+            BIND_METHOD(UdpManager::setPollerOptions));
+  EXPOSE_FN(*runtime, datagram_adopt, 1, BIND_METHOD(UdpManager::adopt));
+  EXPOSE_FN(*runtime, datagram_setJitterBuffer, 2,
+            BIND_METHOD(UdpManager::setJitterBuffer));
+  EXPOSE_FN(*runtime, datagram_getJitterStats, 1,
+            BIND_METHOD(UdpManager::getJitterStats));
+  EXPOSE_FN(*runtime, datagram_getDropStats, 1,
+            BIND_METHOD(UdpManager::getDropStats));
+  EXPOSE_FN(*runtime, datagram_setRecvBufferAutoTune, 2,
+            BIND_METHOD(UdpManager::setRecvBufferAutoTune));
+  EXPOSE_FN(*runtime, datagram_setPriority, 2,
+            BIND_METHOD(UdpManager::setPriority));
+  EXPOSE_FN(*runtime, datagram_setDeliveryOptions, 1,
+            BIND_METHOD(UdpManager::setDeliveryOptions));
+  EXPOSE_FN(*runtime, datagram_getDeliveryStats, 1,
+            BIND_METHOD(UdpManager::getDeliveryStats));
+  EXPOSE_FN(*runtime, datagram_startCapture, 2,
+            BIND_METHOD(UdpManager::startCapture));
+  EXPOSE_FN(*runtime, datagram_stopCapture, 0,
+            BIND_METHOD(UdpManager::stopCapture));
+  EXPOSE_FN(*runtime, datagram_setRemoteInfoMode, 1,
+            BIND_METHOD(UdpManager::setRemoteInfoMode));
+
+  auto global = runtime->global();
+  global.setProperty(*runtime, "dgc_UNIX_DGRAM", UNIX_DGRAM);
+  global.setProperty(*runtime, "dgc_SOL_SOCKET", static_cast<int>(SOL_SOCKET));
+  global.setProperty(*runtime, "dgc_IPPROTO_IP", static_cast<int>(IPPROTO_IP));
+  global.setProperty(*runtime, "dgc_IPPROTO_IPV6",
+                     static_cast<int>(IPPROTO_IPV6));
+  global.setProperty(*runtime, "dgc_SO_REUSEADDR",
+                     static_cast<int>(SO_REUSEADDR));
+  global.setProperty(*runtime, "dgc_SO_REUSEPORT",
+                     static_cast<int>(SO_REUSEPORT));
+  global.setProperty(*runtime, "dgc_SO_BROADCAST",
+                     static_cast<int>(SO_BROADCAST));
+  global.setProperty(*runtime, "dgc_SO_RCVBUF", static_cast<int>(SO_RCVBUF));
+  global.setProperty(*runtime, "dgc_SO_SNDBUF", static_cast<int>(SO_SNDBUF));
+  global.setProperty(*runtime, "dgc_IP_MULTICAST_TTL",
+                     static_cast<int>(IP_MULTICAST_TTL));
+  global.setProperty(*runtime, "dgc_IP_MULTICAST_LOOP",
+                     static_cast<int>(IP_MULTICAST_LOOP));
+  global.setProperty(*runtime, "dgc_IP_ADD_MEMBERSHIP",
+                     static_cast<int>(IP_ADD_MEMBERSHIP));
+  global.setProperty(*runtime, "dgc_IP_DROP_MEMBERSHIP",
+                     static_cast<int>(IP_DROP_MEMBERSHIP));
+  global.setProperty(*runtime, "dgc_IP_TTL", static_cast<int>(IP_TTL));
+  global.setProperty(*runtime, "dgc_IP_RECVPKTINFO",
+                     static_cast<int>(IP_RECVPKTINFO));
+  global.setProperty(*runtime, "dgc_IPV6_RECVPKTINFO",
+                     static_cast<int>(IPV6_RECVPKTINFO));
+  global.setProperty(*runtime, "dgc_IP_TOS", static_cast<int>(IP_TOS));
+  global.setProperty(*runtime, "dgc_IP_RECVTOS", static_cast<int>(IP_RECVTOS));
+  global.setProperty(*runtime, "dgc_IPV6_TCLASS",
+                     static_cast<int>(IPV6_TCLASS));
+  global.setProperty(*runtime, "dgc_IPV6_RECVTCLASS",
+                     static_cast<int>(IPV6_RECVTCLASS));
+  global.setProperty(*runtime, "datagram_callbacks", Object(*runtime));
+  global.setProperty(*runtime, "datagram_rinfoStrings",
+                     Object::createFromHostObject(*runtime, strings));
+}
 
-  if (type != 4 && type != 6) {
-    throw JSError(runtime, "E_INVALID_TYPE");
+void UdpManager::uninstall(Runtime *runtime) {
+  std::shared_ptr<RuntimeTarget> target;
+  {
+    std::lock_guard<std::mutex> lock(_targetsMutex);
+    auto it = _targets.find(runtime);
+    if (it == _targets.end()) {
+      return;
+    }
+    target = it->second;
+    _targets.erase(it);
   }
+  // Nothing can take these sockets' callbacks any more; close them so their
+  // fds and native state don't outlive the runtime
+  for (auto id : _router.removeTarget(target.get())) {
+    _core->close(id);
+  }
+}
 
-  auto inetType = type == 4 ? AF_INET : AF_INET6;
-
-  auto fd = socket(inetType, SOCK_DGRAM, 0);
-  if (fd <= 0) {
-    throw JSError(runtime, String::createFromAscii(runtime, error_name(errno)));
+std::shared_ptr<RuntimeTarget> UdpManager::targetFor(Runtime &runtime) {
+  std::lock_guard<std::mutex> lock(_targetsMutex);
+  auto it = _targets.find(&runtime);
+  if (it == _targets.end()) {
+    throw JSError(runtime, "E_NOT_INSTALLED");
   }
+  return it->second;
+}
+
+void UdpManager::closeAll() {
+  _core->closeAll();
+  _router.clear();
+}
 
-  // Set non-blocking for poll-based I/O
-  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+void UdpManager::suspendAll() { _core->suspendAll(); }
 
-  int id = nextId++;
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    idToFdMap[id] = fd;
-  }
+void UdpManager::resumeAll() { _core->resumeAll(); }
 
+JSI_HOST_FUNCTION(UdpManager::create) {
+  auto type = static_cast<int>(arguments[0].asNumber());
+  auto target = targetFor(runtime);
+  auto id = callCore(runtime, [&] { return _core->create(type); });
+  // Events go to the runtime that created the socket
+  _router.route(id, std::move(target));
   return id;
 }
 
 JSI_HOST_FUNCTION(UdpManager::bind) {
   auto id = static_cast<int>(arguments[0].asNumber());
-  auto fd = getFdOrThrow(runtime, id);
   auto type = static_cast<int>(arguments[1].asNumber());
   auto host = arguments[2].asString(runtime).utf8(runtime);
   auto port = static_cast<int>(arguments[3].asNumber());
 
-  long ret = 0;
-  if (type == 4) {
-    struct sockaddr_in addr;
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    ret = inet_pton(AF_INET, host.c_str(), &(addr.sin_addr));
-    if (ret == 1) {
-      if (setupIface(fd, addr) != 0) {
-        throw JSError(runtime, error_name(errno));
-      }
-      ret =
-          ::bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
-    }
-  } else {
-    struct sockaddr_in6 addr;
-    addr.sin6_family = AF_INET6;
-    addr.sin6_port = htons(port);
-    ret = inet_pton(AF_INET6, host.c_str(), &(addr.sin6_addr));
-    if (ret == 1) {
-      if (setupIface(fd, addr) != 0) {
-        throw JSError(runtime, error_name(errno));
-      }
-      ret =
-          ::bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
-    }
-  }
-
-  if (ret < 0) {
-    throw JSError(runtime, error_name(errno));
-  }
-
-  watchFd(fd);
+  callCore(runtime, [&] { _core->bind(id, type, host, port); });
 
   return Value::undefined();
 }
 
 JSI_HOST_FUNCTION(UdpManager::close) {
   auto id = static_cast<int>(arguments[0].asNumber());
-  int fd;
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    auto it = idToFdMap.find(id);
-    if (it == idToFdMap.end()) {
-      // Already closed (e.g. by closeAll/suspendAll), treat as no-op
-      return Value::undefined();
-    }
-    fd = it->second;
-    idToFdMap.erase(it);
-  }
-  unwatchFd(fd);
-  ::close(fd);
+  _core->close(id);
+  _router.unroute(id);
   return Value::undefined();
 }
 
@@ -449,91 +392,32 @@ JSI_HOST_FUNCTION(UdpManager::setOpt) {
   auto id = static_cast<int>(arguments[0].asNumber());
   auto level = static_cast<int>(arguments[1].asNumber());
   auto option = static_cast<int>(arguments[2].asNumber());
-  auto fd = getFdOrThrow(runtime, id);
-
-  long result = 0;
-  if (level == SOL_SOCKET) {
-    int value = static_cast<int>(arguments[3].asNumber());
-    result = setsockopt(fd, SOL_SOCKET, option, &value, sizeof(value));
-  } else if (level == IPPROTO_IP) {
-    switch (option) {
-    case IP_TTL:
-    case IP_MULTICAST_TTL:
-    case IP_MULTICAST_LOOP: {
-      int value = static_cast<int>(arguments[3].asNumber());
-      result = setsockopt(fd, IPPROTO_IP, option, &value, sizeof(value));
-      break;
-    }
-    case IP_ADD_MEMBERSHIP:
-    case IP_DROP_MEMBERSHIP: {
-      struct ip_mreq mreq;
-      mreq.imr_multiaddr.s_addr =
-          inet_addr(arguments[3].asString(runtime).utf8(runtime).c_str());
-      if (arguments[4].isString()) {
-        auto value = arguments[4].asString(runtime).utf8(runtime);
-        mreq.imr_interface.s_addr = inet_addr(value.c_str());
-      } else {
-        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
-      }
-      result = setsockopt(fd, IPPROTO_IP, option, &mreq, sizeof(mreq));
-      LOGD("member of %s", inet_ntoa(mreq.imr_multiaddr));
-      break;
-    }
-    default:
-      throw JSError(runtime, "E_INVALID_OPTION");
-    }
-  } else if (level == IPPROTO_IPV6) {
-    switch (option) {
-    case IPV6_MULTICAST_HOPS:
-    case IPV6_MULTICAST_LOOP: {
-      int value = static_cast<int>(arguments[3].asNumber());
-      result = setsockopt(fd, IPPROTO_IPV6, option, &value, sizeof(value));
-      break;
-    }
-    case IPV6_ADD_MEMBERSHIP:
-    case IPV6_DROP_MEMBERSHIP: {
-      struct ipv6_mreq mreq;
-      auto value = arguments[3].asString(runtime).utf8(runtime);
-      auto ret = inet_pton(AF_INET6, value.c_str(), &(mreq.ipv6mr_multiaddr));
-      if (ret != 1) {
-        throw JSError(runtime, error_name(errno));
-      }
-      if (arguments[4].isString()) {
-        auto value = arguments[4].asString(runtime).utf8(runtime);
-        inet_pton(AF_INET6, value.c_str(), &(mreq.ipv6mr_interface));
-      } else {
-        mreq.ipv6mr_interface = 0;
-      }
-      result = setsockopt(fd, IPPROTO_IPV6, option, &mreq, sizeof(mreq));
-      break;
-    }
-    default:
-      throw JSError(runtime, "E_INVALID_OPTION");
+
+  callCore(runtime, [&] {
+    if (arguments[3].isString()) {
+      auto group = arguments[3].asString(runtime).utf8(runtime);
+      auto iface = count > 4 && arguments[4].isString()
+                       ? arguments[4].asString(runtime).utf8(runtime)
+                       : std::string();
+      _core->setMembership(id, level, option, group, iface);
+    } else {
+      auto value = static_cast<int>(arguments[3].asNumber());
+      _core->setOpt(id, level, option, value);
     }
-  } else {
-    throw JSError(runtime, "E_INVALID_LEVEL");
-  }
-  if (result < 0) {
-    throw JSError(runtime, error_name(errno));
-  }
+  });
 
   return Value::undefined();
 }
 
 JSI_HOST_FUNCTION(UdpManager::getOpt) {
   auto id = static_cast<int>(arguments[0].asNumber());
-  auto fd = getFdOrThrow(runtime, id);
   auto level = static_cast<int>(arguments[1].asNumber());
   auto option = static_cast<int>(arguments[2].asNumber());
 
-  if (level == SOL_SOCKET) {
-    uint32_t value;
-    socklen_t len = sizeof(value);
-    auto result = getsockopt(fd, level, option, &value, &len);
-    if (result < 0) {
-      throw JSError(runtime, error_name(errno));
-    }
-    return static_cast<int>(value);
+  auto value =
+      callCore(runtime, [&] { return _core->getOpt(id, level, option); });
+  if (value) {
+    return *value;
   }
 
   return Value::undefined();
@@ -541,322 +425,455 @@ JSI_HOST_FUNCTION(UdpManager::getOpt) {
 
 JSI_HOST_FUNCTION(UdpManager::send) {
   auto id = static_cast<int>(arguments[0].asNumber());
-  auto fd = getFdOrThrow(runtime, id);
   auto type = static_cast<int>(arguments[1].asNumber());
   auto host = arguments[2].asString(runtime).utf8(runtime);
   auto port = static_cast<int>(arguments[3].asNumber());
   auto data = arguments[4].asObject(runtime).getArrayBuffer(runtime);
 
-  struct sockaddr_in addr4;
-  struct sockaddr_in6 addr6;
-  struct sockaddr *addrPtr;
-  socklen_t addrLen;
-
-  if (type == 4) {
-    addr4.sin_family = AF_INET;
-    addr4.sin_port = htons(port);
-    if (inet_pton(AF_INET, host.c_str(), &(addr4.sin_addr)) != 1) {
-      throw JSError(runtime, "EINVAL");
+  SendOptions options;
+  if (count > 5 && arguments[5].isObject()) {
+    auto source = arguments[5].asObject(runtime);
+    auto address = source.getProperty(runtime, "address");
+    if (address.isString()) {
+      options.sourceAddress = address.asString(runtime).utf8(runtime);
     }
-    addrPtr = reinterpret_cast<struct sockaddr *>(&addr4);
-    addrLen = sizeof(addr4);
-  } else {
-    addr6.sin6_family = AF_INET6;
-    addr6.sin6_port = htons(port);
-    if (inet_pton(AF_INET6, host.c_str(), &(addr6.sin6_addr)) != 1) {
-      throw JSError(runtime, "EINVAL");
-    }
-    addrPtr = reinterpret_cast<struct sockaddr *>(&addr6);
-    addrLen = sizeof(addr6);
+    options.ifindex = static_cast<unsigned int>(checkedNumber(
+        runtime, source, "interfaceIndex", options.ifindex, 0, MAX_UINT32));
+    // -1 keeps the socket's own TOS
+    options.tos = static_cast<int>(
+        checkedNumber(runtime, source, "tos", options.tos, -1, 255));
   }
 
-  auto ret = sendto(fd, data.data(runtime), data.size(runtime), MSG_DONTWAIT,
-                    addrPtr, addrLen);
-
-  if (ret < 0 && errno != EWOULDBLOCK && errno != EAGAIN) {
-    throw JSError(runtime, error_name(errno));
-  }
+  callCore(runtime, [&] {
+    _core->send(id, type, host, port, data.data(runtime), data.size(runtime),
+                options);
+  });
 
   return Value::undefined();
 }
 
+JSI_HOST_FUNCTION(UdpManager::sendRequest) {
+  auto id = static_cast<int>(arguments[0].asNumber());
+  auto type = static_cast<int>(arguments[1].asNumber());
+  auto host = arguments[2].asString(runtime).utf8(runtime);
+  auto port = static_cast<int>(arguments[3].asNumber());
+  auto data = arguments[4].asObject(runtime).getArrayBuffer(runtime);
+
+  if (count < 6 || !arguments[5].isObject()) {
+    throw JSError(runtime, "EINVAL");
+  }
+  auto object = arguments[5].asObject(runtime);
+  auto number = [&](const char *name, double fallback, double min,
+                    double max) {
+    return checkedNumber(runtime, object, name, fallback, min, max);
+  };
+
+  RequestOptions options;
+  // The token length is required; NaN fails the range check
+  options.tokenLength = static_cast<size_t>(
+      number("tokenLength", std::numeric_limits<double>::quiet_NaN(), 1,
+             std::numeric_limits<uint32_t>::max()));
+  options.tokenOffset = static_cast<size_t>(
+      number("tokenOffset", 0, 0, std::numeric_limits<uint32_t>::max()));
+  auto anySource = object.getProperty(runtime, "anySource");
+  options.anySource = anySource.isBool() && anySource.getBool();
+  options.retries = static_cast<int>(number(
+      "retries", options.retries, 0, std::numeric_limits<int>::max()));
+  options.timeoutUs = static_cast<uint32_t>(
+      number("timeoutMs", options.timeoutUs / 1000.0, 0.001,
+             std::numeric_limits<uint32_t>::max() / 1000.0) *
+      1000);
+  options.backoff = number("backoff", options.backoff, 1, 1e6);
+
+  auto requestId = callCore(runtime, [&] {
+    return _core->sendRequest(id, type, host, port, data.data(runtime),
+                              data.size(runtime), options);
+  });
+  return static_cast<double>(requestId);
+}
+
 JSI_HOST_FUNCTION(UdpManager::getSockName) {
   auto id = static_cast<int>(arguments[0].asNumber());
-  auto fd = getFdOrThrow(runtime, id);
   int type = static_cast<int>(arguments[1].asNumber());
 
+  auto name = callCore(runtime, [&] { return _core->getSockName(id, type); });
+
   auto result = Object(runtime);
-  if (type == 4) {
-    struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
-    auto ret = getsockname(fd, (struct sockaddr *)&addr, &len);
-    if (ret < 0) {
-      throw JSError(runtime, error_name(errno));
-    }
-    auto host = inet_ntoa(addr.sin_addr);
-    auto port = ntohs(addr.sin_port);
-    result.setProperty(runtime, "address",
-                       String::createFromAscii(runtime, host));
-    result.setProperty(runtime, "port", static_cast<int>(port));
-    result.setProperty(runtime, "family",
-                       String::createFromAscii(runtime, "IPv4"));
-  } else {
-    struct sockaddr_in6 addr;
-    socklen_t len = sizeof(addr);
-    auto ret = getsockname(fd, (struct sockaddr *)&addr, &len);
-    if (ret < 0) {
-      throw JSError(runtime, error_name(errno));
-    }
-    char host[INET6_ADDRSTRLEN];
-    inet_ntop(AF_INET6, &addr.sin6_addr, host, INET6_ADDRSTRLEN);
-    auto port = ntohs(addr.sin6_port);
-    result.setProperty(runtime, "address",
-                       String::createFromAscii(runtime, host));
-    result.setProperty(runtime, "port", static_cast<int>(port));
-    result.setProperty(runtime, "family",
-                       String::createFromAscii(runtime, "IPv6"));
-  }
+  result.setProperty(runtime, "address",
+                     String::createFromUtf8(runtime, name.address));
+  result.setProperty(runtime, "port", name.port);
+  result.setProperty(runtime, "family",
+                     String::createFromAscii(runtime, familyName(name.family)));
   return result;
 }
 
-void UdpManager::receiveEvent() {
-  while (!_invalidate) {
-    std::unique_lock<std::mutex> lock(mutex);
-    cond.wait(lock, [this] { return _invalidate || !events.empty(); });
-    if (_invalidate) {
-      break;
-    }
-    auto event = events.front();
-    events.pop();
-    // Look up id while still holding the lock to avoid data race on idToFdMap
-    auto it = std::find_if(
-                 idToFdMap.begin(), idToFdMap.end(),
-                 [&event](const auto &pair) { return pair.second == event.fd; });
-    if (it == idToFdMap.end()) {
-      lock.unlock();
-      continue; // Socket was closed before we could process the event
+JSI_HOST_FUNCTION(UdpManager::setSuspendMode) {
+  auto mode = arguments[0].asString(runtime).utf8(runtime);
+  auto holdBytes = static_cast<size_t>(
+      checkedNumber(runtime, arguments[1],
+                    std::numeric_limits<double>::quiet_NaN(), 0,
+                    std::numeric_limits<uint32_t>::max()));
+
+  if (mode != "warm" && mode != "cold") {
+    throw JSError(runtime, "E_INVALID_MODE");
+  }
+  callCore(runtime, [&] {
+    _core->setSuspendMode(mode == "warm" ? SuspendMode::Warm
+                                         : SuspendMode::Cold,
+                          holdBytes);
+  });
+
+  return Value::undefined();
+}
+
+JSI_HOST_FUNCTION(UdpManager::setPollerOptions) {
+  PollerConfig config;
+  if (count > 0 && arguments[0].isObject()) {
+    auto options = arguments[0].asObject(runtime);
+    config.spinUs = static_cast<uint32_t>(
+        checkedNumber(runtime, options, "spinUs", 0, 0, MAX_UINT32));
+    // Passed to setsockopt as an int
+    config.busyPollUs = static_cast<uint32_t>(
+        checkedNumber(runtime, options, "busyPollUs", 0, 0,
+                      std::numeric_limits<int>::max()));
+    auto priority = options.getProperty(runtime, "priority");
+    if (priority.isNumber()) {
+      config.priority = static_cast<int>(
+          checkedNumber(runtime, priority, 0, -20, 19));
     }
-    int id = it->first;
-    lock.unlock();
-    runOnJS([this, id, event = std::move(event)]() {
-      try {
-        auto callback =
-            _runtime->global()
-                .getPropertyAsObject(*_runtime, "datagram_callbacks")
-                .getPropertyAsFunction(*_runtime, std::to_string(id).c_str());
-        auto eventObj = Object(*_runtime);
-        eventObj.setProperty(*_runtime, "type",
-                             String::createFromAscii(
-                                 *_runtime, event.type == MESSAGE ? "message"
-                                            : event.type == ERROR ? "error"
-                                                                  : "close"));
-        if (event.type == MESSAGE) {
-          auto ArrayBuffer = _runtime->global().getPropertyAsFunction(
-              *_runtime, "ArrayBuffer");
-          auto arrayBufferObj =
-              ArrayBuffer
-                  .callAsConstructor(*_runtime,
-                                     static_cast<int>(event.data.size()))
-                  .getObject(*_runtime);
-          auto arrayBuffer = arrayBufferObj.getArrayBuffer(*_runtime);
-          memcpy(arrayBuffer.data(*_runtime), event.data.c_str(),
-                 event.data.size());
-          eventObj.setProperty(*_runtime, "data", std::move(arrayBuffer));
-          eventObj.setProperty(
-              *_runtime, "family",
-              String::createFromAscii(
-                  *_runtime, event.family == AF_INET ? "IPv4" : "IPv6"));
-          eventObj.setProperty(
-              *_runtime, "address",
-              String::createFromAscii(*_runtime, event.address));
-          eventObj.setProperty(*_runtime, "port", static_cast<int>(event.port));
-        } else if (event.type == ERROR) {
-          auto Error =
-              _runtime->global().getPropertyAsFunction(*_runtime, "Error");
-          auto errorObj =
-              Error
-                  .callAsConstructor(
-                      *_runtime, String::createFromAscii(*_runtime, event.data))
-                  .getObject(*_runtime);
-          eventObj.setProperty(*_runtime, "error", errorObj);
-        }
-        callback.call(*_runtime, eventObj);
-      } catch (const std::exception &e) {
-        LOGW("Error in receiveEvent: %s", e.what());
+    auto cpus = options.getProperty(runtime, "cpus");
+    if (cpus.isObject() && cpus.asObject(runtime).isArray(runtime)) {
+      auto array = cpus.asObject(runtime).getArray(runtime);
+      for (size_t i = 0; i < array.size(runtime); i++) {
+        // Required: NaN fails the check for entries that aren't numbers
+        config.cpus.push_back(static_cast<int>(checkedNumber(
+            runtime, array.getValueAtIndex(runtime, i),
+            std::numeric_limits<double>::quiet_NaN(), 0,
+            std::numeric_limits<int>::max())));
       }
-    });
+    }
+    config.readBudget = static_cast<uint32_t>(checkedNumber(
+        runtime, options, "readBudget", config.readBudget, 0, MAX_UINT32));
   }
-}
 
-void UdpManager::sendEvent(Event event) {
-  if (_invalidate)
-    return;
-  std::lock_guard<std::mutex> lock(mutex);
-  events.push(event);
-  cond.notify_one();
+  callCore(runtime, [&] { _core->setPollerConfig(config); });
+
+  return Value::undefined();
 }
 
-void UdpManager::suspendAll() {
-  std::map<int, int> snapshot;
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    snapshot = idToFdMap;
-    idToFdMap.clear();
+JSI_HOST_FUNCTION(UdpManager::adopt) {
+  auto id = static_cast<int>(arguments[0].asNumber());
+  if (!_core->exists(id)) {
+    throw JSError(runtime, "EBADF");
   }
+  // Move the socket's callbacks to the calling runtime
+  _router.route(id, targetFor(runtime));
+  return Value::undefined();
+}
 
-  {
-    std::lock_guard<std::mutex> lock(_watchMutex);
-    _watchedFds.clear();
+JSI_HOST_FUNCTION(UdpManager::setJitterBuffer) {
+  auto id = static_cast<int>(arguments[0].asNumber());
+
+  std::optional<JitterConfig> config;
+  if (count > 1 && arguments[1].isObject()) {
+    auto options = arguments[1].asObject(runtime);
+    auto number = [&](const char *name, double fallback, double min,
+                      double max) {
+      return checkedNumber(runtime, options, name, fallback, min, max);
+    };
+    config.emplace();
+    config->seqOffset =
+        static_cast<size_t>(number("seqOffset", 2, 0, MAX_UINT32));
+    config->seqBytes = static_cast<size_t>(number("seqBytes", 2, 1, 8));
+    config->timestampOffset = static_cast<int>(number(
+        "timestampOffset", 4, -1, std::numeric_limits<int>::max()));
+    config->timestampBytes =
+        static_cast<size_t>(number("timestampBytes", 4, 1, 8));
+    config->clockRate =
+        static_cast<uint32_t>(number("clockRate", 0, 0, MAX_UINT32));
+    config->packetIntervalUs = static_cast<uint32_t>(
+        number("packetIntervalMs", 0, 0, MAX_UINT32 / 1000) * 1000);
+    config->playoutDelayUs = static_cast<uint32_t>(
+        number("playoutDelayMs", 40, 0, MAX_UINT32 / 1000) * 1000);
+    config->window = static_cast<size_t>(number("window", 64, 1, MAX_UINT32));
+  }
+
+  callCore(runtime, [&] { _core->setJitterBuffer(id, config); });
+
+  return Value::undefined();
+}
+
+JSI_HOST_FUNCTION(UdpManager::getJitterStats) {
+  auto id = static_cast<int>(arguments[0].asNumber());
+
+  auto stats = callCore(runtime, [&] { return _core->getJitterStats(id); });
+  if (!stats) {
+    return Value::undefined();
   }
-  wakePoller();
 
-  if (snapshot.empty()) {
-    return;
+  auto result = Object(runtime);
+  result.setProperty(runtime, "received", static_cast<double>(stats->received));
+  result.setProperty(runtime, "released", static_cast<double>(stats->released));
+  result.setProperty(runtime, "lost", static_cast<double>(stats->lost));
+  result.setProperty(runtime, "reordered",
+                     static_cast<double>(stats->reordered));
+  result.setProperty(runtime, "late", static_cast<double>(stats->late));
+  result.setProperty(runtime, "duplicates",
+                     static_cast<double>(stats->duplicates));
+  return result;
+}
+
+JSI_HOST_FUNCTION(UdpManager::getDropStats) {
+  auto id = static_cast<int>(arguments[0].asNumber());
+
+  auto stats = callCore(runtime, [&] { return _core->getDropStats(id); });
+
+  auto result = Object(runtime);
+  result.setProperty(runtime, "drops", static_cast<double>(stats.drops));
+  result.setProperty(runtime, "supported", stats.supported);
+  result.setProperty(runtime, "recvBufferSize", stats.recvBufferSize);
+  return result;
+}
+
+JSI_HOST_FUNCTION(UdpManager::setRecvBufferAutoTune) {
+  auto id = static_cast<int>(arguments[0].asNumber());
+
+  std::optional<RecvBufferTuning> tuning;
+  if (count > 1 && arguments[1].isObject()) {
+    auto options = arguments[1].asObject(runtime);
+    auto number = [&](const char *name, double fallback, double max) {
+      return checkedNumber(runtime, options, name, fallback, 0, max);
+    };
+    constexpr double maxInt = std::numeric_limits<int>::max();
+    tuning.emplace();
+    tuning->minBytes = static_cast<int>(number("min", 0, maxInt));
+    tuning->maxBytes =
+        static_cast<int>(number("max", tuning->maxBytes, maxInt));
+    tuning->quietMs =
+        static_cast<uint32_t>(number("quietMs", 10000, MAX_UINT32));
   }
 
-  std::vector<SocketState> nextSuspendedSockets;
-  nextSuspendedSockets.reserve(snapshot.size());
-
-  for (const auto &[id, fd] : snapshot) {
-    SocketState state{};
-    state.id = id;
-
-    bool capturedState = false;
-    struct sockaddr_storage addrStorage;
-    socklen_t len = sizeof(addrStorage);
-    if (getsockname(fd, reinterpret_cast<struct sockaddr *>(&addrStorage), &len) ==
-        0) {
-      if (addrStorage.ss_family == AF_INET) {
-        auto *addr = reinterpret_cast<struct sockaddr_in *>(&addrStorage);
-        state.address = inet_ntoa(addr->sin_addr);
-        state.port = ntohs(addr->sin_port);
-        state.type = 4;
-        capturedState = true;
-      } else if (addrStorage.ss_family == AF_INET6) {
-        auto *addr = reinterpret_cast<struct sockaddr_in6 *>(&addrStorage);
-        char host[INET6_ADDRSTRLEN];
-        if (inet_ntop(AF_INET6, &(addr->sin6_addr), host, INET6_ADDRSTRLEN) !=
-            nullptr) {
-          state.address = host;
-          state.port = ntohs(addr->sin6_port);
-          state.type = 6;
-          capturedState = true;
-        }
-      } else {
-        LOGW("Unsupported UDP socket family %d for %d", addrStorage.ss_family, id);
-      }
+  callCore(runtime, [&] { _core->setRecvBufferTuning(id, tuning); });
 
-      if (capturedState) {
-        int value;
-        socklen_t optlen = sizeof(value);
-        if (getsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &value, &optlen) == 0) {
-          state.reuseAddr = value;
-        }
-        if (getsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &value, &optlen) == 0) {
-          state.reusePort = value;
-        }
-        if (getsockopt(fd, SOL_SOCKET, SO_BROADCAST, &value, &optlen) == 0) {
-          state.broadcast = value;
-        }
-      }
-    } else {
-      auto error = error_name(errno);
-      LOGW("Failed to snapshot UDP socket %d: %s", id, error.c_str());
-    }
+  return Value::undefined();
+}
 
-    if (capturedState) {
-      nextSuspendedSockets.push_back(std::move(state));
-    }
+JSI_HOST_FUNCTION(UdpManager::setPriority) {
+  auto id = static_cast<int>(arguments[0].asNumber());
+  auto priority = arguments[1].asString(runtime).utf8(runtime);
 
-    ::close(fd);
+  if (priority != "high" && priority != "normal") {
+    throw JSError(runtime, "E_INVALID_PRIORITY");
   }
+  callCore(runtime, [&] {
+    _core->setPriority(id, priority == "high" ? Priority::High
+                                              : Priority::Normal);
+  });
 
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    suspendedSockets.insert(suspendedSockets.end(), nextSuspendedSockets.begin(),
-                            nextSuspendedSockets.end());
+  return Value::undefined();
+}
+
+JSI_HOST_FUNCTION(UdpManager::setDeliveryOptions) {
+  DeliveryConfig config;
+  if (count > 0 && arguments[0].isObject()) {
+    auto options = arguments[0].asObject(runtime);
+    config.normalWindow = static_cast<size_t>(
+        checkedNumber(runtime, options, "normalWindow", config.normalWindow,
+                      0, MAX_UINT32));
+    config.windowTimeoutUs = static_cast<uint32_t>(
+        checkedNumber(runtime, options, "windowTimeoutMs",
+                      config.windowTimeoutUs / 1000.0, 0, MAX_UINT32 / 1000) *
+        1000);
   }
 
-  cond.notify_all();
+  callCore(runtime, [&] { _core->setDeliveryConfig(config); });
+
+  return Value::undefined();
 }
 
-void UdpManager::resumeAll() {
-  std::vector<SocketState> states;
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    states.swap(suspendedSockets);
+static Object laneObject(Runtime &runtime, const LaneStats &lane) {
+  auto result = Object(runtime);
+  result.setProperty(runtime, "depth", static_cast<double>(lane.depth));
+  result.setProperty(runtime, "maxDepth", static_cast<double>(lane.maxDepth));
+  result.setProperty(runtime, "delivered", static_cast<double>(lane.delivered));
+  result.setProperty(runtime, "avgWaitUs", static_cast<double>(lane.avgWaitUs));
+  result.setProperty(runtime, "maxWaitUs", static_cast<double>(lane.maxWaitUs));
+  return result;
+}
+
+JSI_HOST_FUNCTION(UdpManager::getDeliveryStats) {
+  auto reset = count > 0 && arguments[0].isBool() && arguments[0].getBool();
+
+  auto stats = _core->getDeliveryStats(reset);
+
+  auto result = Object(runtime);
+  result.setProperty(runtime, "high", laneObject(runtime, stats.high));
+  result.setProperty(runtime, "normal", laneObject(runtime, stats.normal));
+  result.setProperty(runtime, "inFlight", static_cast<double>(stats.inFlight));
+  return result;
+}
+
+JSI_HOST_FUNCTION(UdpManager::startCapture) {
+  auto path = arguments[0].asString(runtime).utf8(runtime);
+
+  CaptureConfig config;
+  if (count > 1 && arguments[1].isObject()) {
+    auto options = arguments[1].asObject(runtime);
+    config.snapLen = static_cast<size_t>(checkedNumber(
+        runtime, options, "snapLen", config.snapLen, 0, MAX_UINT32));
+    config.bufferBytes = static_cast<size_t>(checkedNumber(
+        runtime, options, "bufferBytes", config.bufferBytes, 0, MAX_UINT32));
   }
 
-  std::vector<std::pair<int, int>> reopenedSockets;
-  reopenedSockets.reserve(states.size());
+  callCore(runtime, [&] { _core->startCapture(path, config); });
 
-  for (const auto &state : states) {
-    auto newFd = socket(state.type == 4 ? AF_INET : AF_INET6, SOCK_DGRAM, 0);
-    if (newFd <= 0) {
-      auto error = error_name(errno);
-      LOGW("Failed to recreate UDP socket %d: %s", state.id, error.c_str());
-      continue;
-    }
+  return Value::undefined();
+}
+
+JSI_HOST_FUNCTION(UdpManager::stopCapture) {
+  auto stats = _core->stopCapture();
+  if (!stats) {
+    return Value::undefined();
+  }
 
-    // Set non-blocking for poll-based I/O
-    fcntl(newFd, F_SETFL, fcntl(newFd, F_GETFL, 0) | O_NONBLOCK);
+  auto result = Object(runtime);
+  result.setProperty(runtime, "packets", static_cast<double>(stats->packets));
+  result.setProperty(runtime, "bytes", static_cast<double>(stats->bytes));
+  result.setProperty(runtime, "dropped", static_cast<double>(stats->dropped));
+  return result;
+}
 
-    if (state.reuseAddr) {
-      int value = 1;
-      setsockopt(newFd, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value));
-    }
-    if (state.reusePort) {
-      int value = 1;
-      setsockopt(newFd, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value));
-    }
-    if (state.broadcast) {
-      int value = 1;
-      setsockopt(newFd, SOL_SOCKET, SO_BROADCAST, &value, sizeof(value));
-    }
+JSI_HOST_FUNCTION(UdpManager::setRemoteInfoMode) {
+  auto mode = arguments[0].asString(runtime).utf8(runtime);
+  if (mode != "lazy" && mode != "eager") {
+    throw JSError(runtime, "E_INVALID_MODE");
+  }
 
-    if (state.type == 4) {
-      struct sockaddr_in addr;
-      addr.sin_family = AF_INET;
-      addr.sin_port = htons(state.port);
-      inet_pton(AF_INET, state.address.c_str(), &(addr.sin_addr));
+  auto strings = runtime.global()
+                     .getPropertyAsObject(runtime, "datagram_rinfoStrings")
+                     .getHostObject<RemoteInfoStrings>(runtime);
+  strings->eager = mode == "eager";
 
-      if (setupIface(newFd, addr) == 0 &&
-          ::bind(newFd, reinterpret_cast<struct sockaddr *>(&addr),
-                 sizeof(addr)) == 0) {
-        reopenedSockets.emplace_back(state.id, newFd);
-      } else {
-        auto error = error_name(errno);
-        LOGW("Failed to restore UDP socket %d: %s", state.id, error.c_str());
-        ::close(newFd);
-      }
-    } else {
-      struct sockaddr_in6 addr;
-      addr.sin6_family = AF_INET6;
-      addr.sin6_port = htons(state.port);
-      inet_pton(AF_INET6, state.address.c_str(), &(addr.sin6_addr));
-
-      if (setupIface(newFd, addr) == 0 &&
-          ::bind(newFd, reinterpret_cast<struct sockaddr *>(&addr),
-                 sizeof(addr)) == 0) {
-        reopenedSockets.emplace_back(state.id, newFd);
+  return Value::undefined();
+}
+
+// Build the JS event object and call the socket's callback.
+static void emitEvent(Runtime &runtime,
+                      const std::shared_ptr<AddressCache> &cache,
+                      const std::shared_ptr<RemoteInfoStrings> &strings,
+                      int id, const Event &event) {
+  try {
+    auto callback =
+        runtime.global()
+            .getPropertyAsObject(runtime, "datagram_callbacks")
+            .getPropertyAsFunction(runtime, std::to_string(id).c_str());
+    auto eventObj = Object(runtime);
+    const char *type = "close";
+    switch (event.type) {
+    case MESSAGE:
+      type = "message";
+      break;
+    case ERROR:
+      type = "error";
+      break;
+    case REPLY:
+      type = "reply";
+      break;
+    case TIMEOUT:
+      type = "timeout";
+      break;
+    case CLOSE:
+      break;
+    }
+    eventObj.setProperty(runtime, "type",
+                         String::createFromAscii(runtime, type));
+    if (event.type == REPLY || event.type == TIMEOUT) {
+      eventObj.setProperty(runtime, "requestId",
+                           static_cast<double>(event.requestId));
+    }
+    if (event.type == MESSAGE || event.type == REPLY) {
+      auto ArrayBuffer =
+          runtime.global().getPropertyAsFunction(runtime, "ArrayBuffer");
+      auto arrayBufferObj =
+          ArrayBuffer
+              .callAsConstructor(runtime, static_cast<int>(event.data.size()))
+              .getObject(runtime);
+      auto arrayBuffer = arrayBufferObj.getArrayBuffer(runtime);
+      memcpy(arrayBuffer.data(runtime), event.data.c_str(), event.data.size());
+      eventObj.setProperty(runtime, "data", std::move(arrayBuffer));
+      if (strings->eager) {
+        eventObj.setProperty(
+            runtime, "rinfo",
+            RemoteInfo(event, cache, strings).toObject(runtime));
       } else {
-        auto error = error_name(errno);
-        LOGW("Failed to restore UDP socket %d: %s", state.id, error.c_str());
-        ::close(newFd);
+        auto rinfo = std::make_shared<RemoteInfo>(event, cache, strings);
+        eventObj.setProperty(
+            runtime, "rinfo",
+            Object::createFromHostObject(runtime, std::move(rinfo)));
       }
+    } else if (event.type == ERROR) {
+      auto Error = runtime.global().getPropertyAsFunction(runtime, "Error");
+      auto errorObj =
+          Error
+              .callAsConstructor(runtime,
+                                 String::createFromAscii(runtime, event.data))
+              .getObject(runtime);
+      eventObj.setProperty(runtime, "error", errorObj);
     }
+    callback.call(runtime, eventObj);
+  } catch (const std::exception &e) {
+    LOGW("Error in emitEvent: %s", e.what());
   }
+}
 
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    for (const auto &[id, fd] : reopenedSockets) {
-      idToFdMap[id] = fd;
+void RuntimeTarget::deliver(int id, Event &&event) {
+  if (!_callInvoker) {
+    return;
+  }
+  auto done = consumeGuard(event.windowed ? 1 : 0);
+  // Capture by value: the target may be uninstalled before this runs
+  _callInvoker->invokeAsync([runtime = _runtime, cache = _cache,
+                             weakStrings = _strings, done, id,
+                             event = std::move(event)]() {
+    JSIUDP_TRACE_SCOPE("jsiudp js callback");
+    // Released along with the runtime
+    if (auto strings = weakStrings.lock()) {
+      emitEvent(*runtime, cache, strings, id, event);
     }
+  });
+}
+
+void RuntimeTarget::deliverBatch(EventBatch &&batch) {
+  if (!_callInvoker) {
+    return;
   }
+  auto done = consumeGuard(std::count_if(
+      batch.begin(), batch.end(),
+      [](const auto &item) { return item.second.windowed; }));
+  // One trip through the JS queue for the whole batch
+  _callInvoker->invokeAsync([runtime = _runtime, cache = _cache,
+                             weakStrings = _strings, done,
+                             batch = std::move(batch)]() {
+    JSIUDP_TRACE_SCOPE("jsiudp js callback");
+    JSIUDP_TRACE_COUNTER("jsiudp js batch", batch.size());
+    if (auto strings = weakStrings.lock()) {
+      for (const auto &[id, event] : batch) {
+        emitEvent(*runtime, cache, strings, id, event);
+      }
+    }
+  });
+}
 
-  for (const auto &socket : reopenedSockets) {
-    watchFd(socket.second);
+// Fires when the last copy of the JS closure goes away, whether it ran or
+// was dropped with the queue, so the delivery window can't leak.
+std::shared_ptr<void> RuntimeTarget::consumeGuard(size_t windowedEvents) const {
+  if (windowedEvents == 0 || !_onConsumed) {
+    return nullptr;
   }
+  return std::shared_ptr<void>(
+      nullptr, [onConsumed = _onConsumed, windowedEvents](void *) {
+        onConsumed(windowedEvents);
+      });
 }
 
 } // namespace jsiudp
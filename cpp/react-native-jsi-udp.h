@@ -1,73 +1,133 @@
 #pragma once
+#include "address-cache.h"
+#include "event-router.h"
 #include "helper.h"
+#include "udp-core.h"
 #include <ReactCommon/CallInvoker.h>
-#include <atomic>
-#include <condition_variable>
-#include <functional>
 #include <jsi/jsi.h>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
-#include <queue>
-#include <set>
+#include <optional>
 #include <string>
-#include <thread>
-#include <tuple>
-
-#if __APPLE__
-
-#define LOGI(...)                                                              \
-  printf("[JsiUdp] INFO: ");                                                   \
-  printf(__VA_ARGS__);                                                         \
-  printf("\n")
-#define LOGD(...)                                                              \
-  printf("[JsiUdp] DEBUG: ");                                                  \
-  printf(__VA_ARGS__);                                                         \
-  printf("\n")
-#define LOGW(...)                                                              \
-  printf("[JsiUdp] WARN: ");                                                   \
-  printf(__VA_ARGS__);                                                         \
-  printf("\n")
-#define LOGE(...)                                                              \
-  printf("[JsiUdp] ERROR: ");                                                  \
-  printf(__VA_ARGS__);                                                         \
-  printf("\n")
-
-#else
-
-#include <android/log.h>
-
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, "JsiUdp", __VA_ARGS__)
-#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "JsiUdp", __VA_ARGS__)
-#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, "JsiUdp", __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "JsiUdp", __VA_ARGS__)
-
-#endif
+#include <unordered_map>
+#include <vector>
 
 namespace jsiudp {
-enum EventType { MESSAGE, ERROR, CLOSE };
-
-struct Event {
-  int fd;
-  EventType type;
-  std::string data;
-  int family;
-  std::string address;
-  int port;
+
+// JS values shared by the rinfo objects of one runtime: the property names,
+// so lookups compare ids instead of converting to UTF-8, and the address
+// strings of recent peers. The runtime owns it (through a hidden global), so
+// it is only used and freed on that runtime's thread.
+class RemoteInfoStrings : public facebook::jsi::HostObject {
+public:
+  enum Prop {
+    ADDRESS,
+    FAMILY,
+    PORT,
+    SIZE,
+    LOCAL_ADDRESS,
+    INTERFACE_INDEX,
+    TOS,
+    DSCP,
+    ECN,
+    PROP_COUNT
+  };
+
+  explicit RemoteInfoStrings(facebook::jsi::Runtime &runtime);
+
+  std::optional<Prop> find(facebook::jsi::Runtime &runtime,
+                           const facebook::jsi::PropNameID &name) const;
+  const facebook::jsi::PropNameID &name(Prop prop) const {
+    return _names[prop];
+  }
+  facebook::jsi::Value address(facebook::jsi::Runtime &runtime,
+                               AddressCache &cache,
+                               const struct sockaddr_storage &addr);
+
+  // Build plain rinfo objects instead of host objects
+  bool eager = false;
+
+private:
+  static constexpr size_t MAX_ADDRESSES = 64;
+
+  std::vector<facebook::jsi::PropNameID> _names;
+  std::unordered_map<std::string, facebook::jsi::String> _addresses;
 };
 
-struct SocketState {
-  int id;
-  std::string address;
-  int port;
-  int type;
-  bool reuseAddr;
-  bool reusePort;
-  bool broadcast;
+// Lazy rinfo for a received message; the host string is only produced (via
+// the shared AddressCache) when JS reads `address`.
+class RemoteInfo : public facebook::jsi::HostObject {
+public:
+  RemoteInfo(const Event &event, std::shared_ptr<AddressCache> cache,
+             std::shared_ptr<RemoteInfoStrings> strings)
+      : _addr(event.remote), _local(event.local), _ifindex(event.ifindex),
+        _tos(event.tos), _size(event.data.size()), _cache(std::move(cache)),
+        _strings(std::move(strings)) {}
+
+  facebook::jsi::Value get(facebook::jsi::Runtime &runtime,
+                           const facebook::jsi::PropNameID &name) override;
+  void set(facebook::jsi::Runtime &runtime,
+           const facebook::jsi::PropNameID &name,
+           const facebook::jsi::Value &value) override;
+  std::vector<facebook::jsi::PropNameID>
+  getPropertyNames(facebook::jsi::Runtime &runtime) override;
+
+  // The same fields as a plain object
+  facebook::jsi::Object toObject(facebook::jsi::Runtime &runtime);
+
+private:
+  struct sockaddr_storage _addr;
+  struct sockaddr_storage _local;
+  unsigned int _ifindex;
+  int _tos;
+  size_t _size;
+  std::shared_ptr<AddressCache> _cache;
+  std::shared_ptr<RemoteInfoStrings> _strings;
+  // Values JS assigned, which shadow the native ones
+  std::unordered_map<std::string, facebook::jsi::Value> _assigned;
+
+  bool has(RemoteInfoStrings::Prop prop) const;
+  facebook::jsi::Value value(facebook::jsi::Runtime &runtime,
+                             RemoteInfoStrings::Prop prop);
 };
 
-class UdpManager {
+// Builds event objects on one JS runtime, scheduled through its invoker.
+class RuntimeTarget : public EventTarget {
 public:
+  RuntimeTarget(facebook::jsi::Runtime *runtime,
+                std::shared_ptr<facebook::react::CallInvoker> callInvoker,
+                std::shared_ptr<AddressCache> cache,
+                std::weak_ptr<RemoteInfoStrings> strings,
+                std::function<void(size_t)> onConsumed)
+      : _runtime(runtime), _callInvoker(std::move(callInvoker)),
+        _cache(std::move(cache)), _strings(std::move(strings)),
+        _onConsumed(std::move(onConsumed)) {}
+
+  void deliver(int id, Event &&event) override;
+  void deliverBatch(EventBatch &&batch) override;
+
+private:
+  facebook::jsi::Runtime *_runtime;
+  std::shared_ptr<facebook::react::CallInvoker> _callInvoker;
+  std::shared_ptr<AddressCache> _cache;
+  // Weak: this target may be released off the runtime's thread
+  std::weak_ptr<RemoteInfoStrings> _strings;
+  // Reports windowed events back to the core once JS has run them
+  std::function<void(size_t)> _onConsumed;
+
+  std::shared_ptr<void> consumeGuard(size_t windowedEvents) const;
+};
+
+class UdpManager : public std::enable_shared_from_this<UdpManager> {
+public:
+  // Creates the manager and installs the datagram_* API on the main runtime.
+  // Host functions only hold it weakly, so the caller keeps it alive.
+  static std::shared_ptr<UdpManager>
+  make(facebook::jsi::Runtime *jsiRuntime,
+       std::shared_ptr<facebook::react::CallInvoker> callInvoker);
+
   UdpManager(facebook::jsi::Runtime *jsiRuntime,
              std::shared_ptr<facebook::react::CallInvoker> callInvoker);
   ~UdpManager();
@@ -76,45 +136,55 @@ public:
   void suspendAll();
   void resumeAll();
 
+  // Expose the datagram_* API on an additional runtime, such as a background
+  // JS or worklet runtime. Sockets created (or adopted) there get their
+  // callbacks through `callInvoker` and never touch the main JS queue. Call
+  // on that runtime's thread, and uninstall before the runtime goes away;
+  // uninstalling closes the sockets it still owns.
+  void install(facebook::jsi::Runtime *runtime,
+               std::shared_ptr<facebook::react::CallInvoker> callInvoker);
+  void uninstall(facebook::jsi::Runtime *runtime);
+
+  // Entry points for platform code hosting secondary runtimes: install on /
+  // uninstall from the live manager. False if there is none, i.e. the main
+  // runtime hasn't installed the module.
+  static bool
+  installRuntime(facebook::jsi::Runtime *runtime,
+                 std::shared_ptr<facebook::react::CallInvoker> callInvoker);
+  static bool uninstallRuntime(facebook::jsi::Runtime *runtime);
+
 protected:
   facebook::jsi::Runtime *_runtime;
   std::shared_ptr<facebook::react::CallInvoker> _callInvoker;
-  std::atomic<bool> _invalidate = false;
-  std::thread eventThread;
+  std::unique_ptr<UdpCore> _core;
+  std::shared_ptr<AddressCache> _addressCache;
+  EventRouter _router;
+
+  std::mutex _targetsMutex;
+  std::map<facebook::jsi::Runtime *, std::shared_ptr<RuntimeTarget>> _targets;
+
+  std::shared_ptr<RuntimeTarget> targetFor(facebook::jsi::Runtime &runtime);
 
   JSI_HOST_FUNCTION(create);
   JSI_HOST_FUNCTION(send);
+  JSI_HOST_FUNCTION(sendRequest);
   JSI_HOST_FUNCTION(bind);
   JSI_HOST_FUNCTION(setOpt);
   JSI_HOST_FUNCTION(getOpt);
   JSI_HOST_FUNCTION(close);
   JSI_HOST_FUNCTION(getSockName);
-
-  void runOnJS(std::function<void()> &&f);
-
-  void sendEvent(Event event);
-  void receiveEvent();
-  int getFdOrThrow(facebook::jsi::Runtime &runtime, int id);
-
-  // poll-based I/O (replaces worker pool busy-polling)
-  void watchFd(int fd);
-  void unwatchFd(int fd);
-  void pollLoop();
-  void wakePoller();
-
-private:
-  std::condition_variable cond;
-  std::mutex mutex;
-  std::queue<Event> events;
-  std::map<int, int> idToFdMap;
-  int nextId = 1;
-
-  // poll-based I/O
-  std::thread _pollThread;
-  int _wakePipe[2] = {-1, -1};
-  std::set<int> _watchedFds;
-  std::mutex _watchMutex;
-
-  std::vector<SocketState> suspendedSockets;
+  JSI_HOST_FUNCTION(setSuspendMode);
+  JSI_HOST_FUNCTION(setPollerOptions);
+  JSI_HOST_FUNCTION(adopt);
+  JSI_HOST_FUNCTION(setJitterBuffer);
+  JSI_HOST_FUNCTION(getJitterStats);
+  JSI_HOST_FUNCTION(getDropStats);
+  JSI_HOST_FUNCTION(setRecvBufferAutoTune);
+  JSI_HOST_FUNCTION(setPriority);
+  JSI_HOST_FUNCTION(setDeliveryOptions);
+  JSI_HOST_FUNCTION(getDeliveryStats);
+  JSI_HOST_FUNCTION(startCapture);
+  JSI_HOST_FUNCTION(stopCapture);
+  JSI_HOST_FUNCTION(setRemoteInfoMode);
 };
 } // namespace jsiudp
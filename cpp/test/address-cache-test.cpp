@@ -0,0 +1,45 @@
+#include "address-cache.h"
+#include "test-util.h"
+#include <arpa/inet.h>
+
+using namespace jsiudp;
+
+namespace {
+
+struct sockaddr_storage ipv4(const char *host, int port) {
+  struct sockaddr_storage addr {};
+  auto &in = reinterpret_cast<struct sockaddr_in &>(addr);
+  in.sin_family = AF_INET;
+  in.sin_port = htons(port);
+  inet_pton(AF_INET, host, &in.sin_addr);
+  return addr;
+}
+
+} // namespace
+
+TEST(addressCacheFormatsOncePerHost) {
+  AddressCache cache(2);
+  EXPECT_EQ(cache.lookup(ipv4("10.0.0.1", 1)), std::string("10.0.0.1"));
+  // The port is not part of the key
+  EXPECT_EQ(cache.lookup(ipv4("10.0.0.1", 2)), std::string("10.0.0.1"));
+  EXPECT_EQ(cache.size(), 1u);
+}
+
+TEST(addressCacheEvictsLeastRecent) {
+  AddressCache cache(2);
+  cache.lookup(ipv4("10.0.0.1", 1));
+  cache.lookup(ipv4("10.0.0.2", 1));
+  cache.lookup(ipv4("10.0.0.1", 1));
+  cache.lookup(ipv4("10.0.0.3", 1));
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(cache.lookup(ipv4("10.0.0.2", 1)), std::string("10.0.0.2"));
+}
+
+TEST(addressCacheFormatsIpv6) {
+  AddressCache cache;
+  struct sockaddr_storage addr {};
+  auto &in6 = reinterpret_cast<struct sockaddr_in6 &>(addr);
+  in6.sin6_family = AF_INET6;
+  inet_pton(AF_INET6, "fe80::1", &in6.sin6_addr);
+  EXPECT_EQ(cache.lookup(addr), std::string("fe80::1"));
+}
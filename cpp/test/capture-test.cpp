@@ -0,0 +1,91 @@
+#include "packet-capture.h"
+#include "test-util.h"
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace jsiudp;
+
+namespace {
+
+struct sockaddr_storage ipv4(const char *host, int port) {
+  struct sockaddr_storage addr {};
+  auto &in = reinterpret_cast<struct sockaddr_in &>(addr);
+  in.sin_family = AF_INET;
+  in.sin_port = htons(port);
+  inet_pton(AF_INET, host, &in.sin_addr);
+  return addr;
+}
+
+std::string tempPath(const char *name) {
+  return "/tmp/jsiudp-test-" + std::to_string(getpid()) + "-" + name;
+}
+
+} // namespace
+
+TEST(captureRoundTrip) {
+  auto path = tempPath("round-trip.pcapng");
+  CaptureConfig config;
+  config.snapLen = 4;
+  {
+    PacketCapture capture(path, config);
+    auto local = ipv4("127.0.0.1", 5000);
+    auto remote = ipv4("10.1.2.3", 6000);
+    capture.record(CaptureDirection::Inbound, -1, remote, local, -1, "hello",
+                   5);
+    capture.record(CaptureDirection::Outbound, -1, remote, local, 0, "hi", 2);
+    capture.finish();
+    auto stats = capture.stats();
+    EXPECT_EQ(stats.packets, 2u);
+    EXPECT_EQ(stats.bytes, 7u);
+    EXPECT_EQ(stats.dropped, 0u);
+  }
+
+  CaptureReader reader(path);
+  CapturedPacket packet;
+  EXPECT(reader.next(packet));
+  EXPECT(packet.direction == CaptureDirection::Inbound);
+  EXPECT_EQ(packet.payload, std::string("hell"));
+  EXPECT_EQ(formatAddress(packet.source), std::string("10.1.2.3"));
+  EXPECT_EQ(addressPort(packet.destination), 5000);
+
+  EXPECT(reader.next(packet));
+  EXPECT(packet.direction == CaptureDirection::Outbound);
+  EXPECT_EQ(packet.payload, std::string("hi"));
+  EXPECT_EQ(addressPort(packet.destination), 6000);
+  EXPECT(!reader.next(packet));
+  unlink(path.c_str());
+}
+
+TEST(captureCountsRecordOverheadAgainstBuffer) {
+  auto path = tempPath("overhead.pcapng");
+  CaptureConfig config;
+  // Far more than the payloads below, far less than their records
+  config.bufferBytes = 1024;
+  PacketCapture capture(path, config);
+  auto local = ipv4("127.0.0.1", 5000);
+  auto remote = ipv4("10.1.2.3", 6000);
+  for (int i = 0; i < 100; i++) {
+    capture.record(CaptureDirection::Inbound, -1, remote, local, -1, "", 0);
+  }
+  capture.finish();
+  auto stats = capture.stats();
+  EXPECT(stats.packets > 0);
+  EXPECT(stats.dropped > 0);
+  EXPECT_EQ(stats.packets + stats.dropped, 100u);
+  unlink(path.c_str());
+}
+
+TEST(captureRejectsOtherFiles) {
+  auto path = tempPath("not-a-capture");
+  auto file = fopen(path.c_str(), "wb");
+  fputs("definitely not a pcap file", file);
+  fclose(file);
+  bool threw = false;
+  try {
+    CaptureReader reader(path);
+  } catch (const UdpError &e) {
+    threw = std::string(e.what()) == "E_INVALID_CAPTURE";
+  }
+  unlink(path.c_str());
+  EXPECT(threw);
+}
@@ -0,0 +1,138 @@
+#include "event-lanes.h"
+#include "test-util.h"
+
+using namespace jsiudp;
+using Clock = EventLanes::Clock;
+using std::chrono::milliseconds;
+
+namespace {
+
+Event event(int fd, Priority priority = Priority::Normal) {
+  Event event{};
+  event.fd = fd;
+  event.type = MESSAGE;
+  event.priority = priority;
+  return event;
+}
+
+std::vector<int> take(EventLanes &lanes, Clock::time_point now) {
+  std::vector<Event> out;
+  lanes.take(now, out);
+  std::vector<int> fds;
+  for (auto &event : out) {
+    fds.push_back(event.fd);
+  }
+  return fds;
+}
+
+} // namespace
+
+TEST(lanesHighPriorityGoesFirst) {
+  EventLanes lanes;
+  auto now = Clock::now();
+  lanes.push(event(1), now);
+  lanes.push(event(2), now);
+  lanes.push(event(3, Priority::High), now);
+  EXPECT_EQ(lanes.ready(now), 3u);
+  auto fds = take(lanes, now);
+  EXPECT_EQ(fds.size(), 3u);
+  EXPECT_EQ(fds[0], 3);
+  EXPECT_EQ(fds[1], 1);
+  EXPECT_EQ(fds[2], 2);
+  EXPECT_EQ(lanes.ready(now), 0u);
+}
+
+TEST(lanesWindowOnlyWhileThrottled) {
+  EventLanes lanes;
+  DeliveryConfig config;
+  config.normalWindow = 2;
+  lanes.setConfig(config);
+  auto now = Clock::now();
+  for (int fd = 0; fd < 5; fd++) {
+    lanes.push(event(fd), now);
+  }
+  EXPECT_EQ(take(lanes, now).size(), 5u);
+
+  lanes.setThrottled(true);
+  for (int fd = 0; fd < 5; fd++) {
+    lanes.push(event(fd), now);
+  }
+  EXPECT_EQ(take(lanes, now).size(), 2u);
+  EXPECT_EQ(lanes.ready(now), 0u);
+  EXPECT_EQ(lanes.stats(false).inFlight, 2u);
+
+  // High priority never waits for the window
+  lanes.push(event(9, Priority::High), now);
+  EXPECT_EQ(lanes.ready(now), 1u);
+  EXPECT_EQ(take(lanes, now).size(), 1u);
+
+  lanes.consumed(1);
+  EXPECT_EQ(take(lanes, Clock::now()).size(), 1u);
+}
+
+TEST(lanesReopenStalledWindow) {
+  EventLanes lanes;
+  DeliveryConfig config;
+  config.normalWindow = 1;
+  config.windowTimeoutUs = 10000;
+  lanes.setConfig(config);
+  lanes.setThrottled(true);
+  auto now = Clock::now();
+  lanes.push(event(1), now);
+  lanes.push(event(2), now);
+  EXPECT_EQ(take(lanes, now).size(), 1u);
+
+  auto aging = lanes.nextAging();
+  EXPECT(aging.has_value());
+  EXPECT(*aging == now + milliseconds(10));
+  EXPECT_EQ(lanes.ready(now + milliseconds(5)), 0u);
+  EXPECT_EQ(lanes.ready(now + milliseconds(10)), 1u);
+  EXPECT_EQ(take(lanes, now + milliseconds(10)).size(), 1u);
+}
+
+TEST(lanesReportDepthAndReset) {
+  EventLanes lanes;
+  auto now = Clock::now();
+  lanes.push(event(1), now);
+  lanes.push(event(2), now);
+  take(lanes, now + milliseconds(3));
+  auto stats = lanes.stats(true);
+  EXPECT_EQ(stats.normal.maxDepth, 2u);
+  EXPECT_EQ(stats.normal.delivered, 2u);
+  EXPECT_EQ(stats.normal.maxWaitUs, 3000u);
+  EXPECT_EQ(lanes.stats(false).normal.delivered, 0u);
+}
+
+TEST(lanesChargeOnlyWindowedEvents) {
+  EventLanes lanes;
+  DeliveryConfig config;
+  config.normalWindow = 1;
+  config.windowTimeoutUs = 1000000;
+  lanes.setConfig(config);
+  auto now = Clock::now();
+
+  // Handed out unthrottled: not charged, so consumers must not ack them
+  lanes.push(event(1), now);
+  lanes.push(event(2), now);
+  std::vector<Event> out;
+  lanes.take(now, out);
+  EXPECT_EQ(out.size(), 2u);
+  EXPECT(!out[0].windowed && !out[1].windowed);
+  EXPECT_EQ(lanes.stats(false).inFlight, 0u);
+
+  lanes.setThrottled(true);
+  lanes.push(event(3), now);
+  lanes.push(event(4), now);
+  out.clear();
+  lanes.take(now, out);
+  EXPECT_EQ(out.size(), 1u);
+  EXPECT(out[0].windowed);
+
+  // The charge outlives a throttle toggle until its ack arrives
+  lanes.setThrottled(false);
+  lanes.setThrottled(true);
+  EXPECT_EQ(lanes.stats(false).inFlight, 1u);
+  EXPECT_EQ(lanes.ready(now), 0u);
+  lanes.consumed(1);
+  EXPECT_EQ(lanes.ready(now), 1u);
+}
@@ -0,0 +1,124 @@
+#include "event-router.h"
+#include "test-util.h"
+#include "udp-core.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace jsiudp;
+
+namespace {
+
+class MockTarget : public EventTarget {
+public:
+  void deliver(int id, Event &&) override { ids.push_back(id); }
+  void deliverBatch(EventBatch &&batch) override {
+    batches++;
+    EventTarget::deliverBatch(std::move(batch));
+  }
+
+  std::vector<int> ids;
+  int batches = 0;
+};
+
+// Counts messages delivered from the I/O thread
+class CountingTarget : public EventTarget {
+public:
+  void deliver(int, Event &&event) override {
+    if (event.type == MESSAGE) {
+      messages++;
+    }
+  }
+
+  std::atomic<int> messages{0};
+};
+
+EventBatch batchOf(std::initializer_list<int> ids) {
+  EventBatch batch;
+  for (auto id : ids) {
+    Event event{};
+    event.type = MESSAGE;
+    batch.emplace_back(id, std::move(event));
+  }
+  return batch;
+}
+
+} // namespace
+
+TEST(routerSplitsBatchesPerTarget) {
+  EventRouter router;
+  auto main = std::make_shared<MockTarget>();
+  auto worker = std::make_shared<MockTarget>();
+  router.route(1, main);
+  router.route(2, worker);
+  router.route(3, main);
+
+  router.dispatchBatch(batchOf({1, 2, 3, 2}));
+  EXPECT_EQ(main->batches, 1);
+  EXPECT_EQ(worker->batches, 1);
+  EXPECT_EQ(main->ids.size(), 2u);
+  EXPECT_EQ(main->ids[0], 1);
+  EXPECT_EQ(main->ids[1], 3);
+  EXPECT_EQ(worker->ids.size(), 2u);
+}
+
+TEST(routerDropsRemovedTargetsEvents) {
+  EventRouter router;
+  auto main = std::make_shared<MockTarget>();
+  auto worker = std::make_shared<MockTarget>();
+  router.route(1, main);
+  router.route(2, worker);
+  router.route(3, worker);
+
+  auto owned = router.removeTarget(worker.get());
+  std::sort(owned.begin(), owned.end());
+  EXPECT_EQ(owned.size(), 2u);
+  EXPECT_EQ(owned[0], 2);
+  EXPECT_EQ(owned[1], 3);
+
+  // Nothing leaks to the remaining target
+  router.dispatchBatch(batchOf({1, 2, 3}));
+  router.dispatch(2, Event{});
+  EXPECT_EQ(main->ids.size(), 1u);
+  EXPECT(worker->ids.empty());
+}
+
+TEST(routerDropsEventsAfterUnroute) {
+  EventRouter router;
+  auto main = std::make_shared<MockTarget>();
+  auto worker = std::make_shared<MockTarget>();
+  router.route(1, main);
+  router.route(2, worker);
+
+  router.unroute(2);
+  router.dispatchBatch(batchOf({2, 1}));
+  router.dispatch(2, Event{});
+  EXPECT_EQ(main->ids.size(), 1u);
+  EXPECT(worker->ids.empty());
+}
+
+// What UdpManager::adopt does for a socket created on another runtime
+TEST(routerDeliversAdoptedSocketToNewTarget) {
+  EventRouter router;
+  auto main = std::make_shared<CountingTarget>();
+  auto worker = std::make_shared<CountingTarget>();
+  UdpCore core(
+      [&router](EventBatch &&batch) { router.dispatchBatch(std::move(batch)); },
+      DispatchMode::Direct);
+  auto server = core.create(4);
+  core.bind(server, 4, "127.0.0.1", 0);
+  router.route(server, main);
+  auto client = core.create(4);
+  router.route(client, main);
+
+  router.route(server, worker);
+  core.send(client, 4, "127.0.0.1", core.getSockName(server, 4).port, "ping",
+            4);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (worker->messages == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(worker->messages.load(), 1);
+  EXPECT_EQ(main->messages.load(), 0);
+}
@@ -0,0 +1,200 @@
+#include "jitter-buffer.h"
+#include "test-util.h"
+
+using namespace jsiudp;
+using Clock = JitterBuffer::Clock;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+namespace {
+
+// RTP-shaped payload: sequence number at 2, timestamp at 4, big-endian
+Event packet(uint16_t seq, uint32_t timestamp = 0) {
+  Event event{};
+  event.type = MESSAGE;
+  event.data.assign(12, '\0');
+  event.data[2] = static_cast<char>(seq >> 8);
+  event.data[3] = static_cast<char>(seq);
+  for (int i = 0; i < 4; i++) {
+    event.data[4 + i] = static_cast<char>(timestamp >> (24 - 8 * i));
+  }
+  return event;
+}
+
+uint16_t seqOf(const Event &event) {
+  return static_cast<uint16_t>(static_cast<uint8_t>(event.data[2]) << 8 |
+                               static_cast<uint8_t>(event.data[3]));
+}
+
+std::vector<uint16_t> popSeqs(JitterBuffer &buffer, Clock::time_point now) {
+  std::vector<Event> out;
+  buffer.pop(now, out);
+  std::vector<uint16_t> seqs;
+  for (auto &event : out) {
+    seqs.push_back(seqOf(event));
+  }
+  return seqs;
+}
+
+JitterConfig intervalConfig() {
+  JitterConfig config;
+  config.packetIntervalUs = 2000;
+  config.playoutDelayUs = 20000;
+  return config;
+}
+
+} // namespace
+
+TEST(jitterReordersWithinDelay) {
+  JitterBuffer buffer(intervalConfig());
+  auto start = Clock::now();
+  auto p0 = packet(0);
+  auto p2 = packet(2);
+  auto p1 = packet(1);
+  EXPECT(buffer.push(p0, start));
+  EXPECT(buffer.push(p2, start + microseconds(4000)));
+  EXPECT(buffer.push(p1, start + microseconds(5000)));
+
+  EXPECT(popSeqs(buffer, start + microseconds(19000)).empty());
+  auto seqs = popSeqs(buffer, start + microseconds(30000));
+  EXPECT_EQ(seqs.size(), 3u);
+  EXPECT_EQ(seqs[0], 0);
+  EXPECT_EQ(seqs[1], 1);
+  EXPECT_EQ(seqs[2], 2);
+
+  auto stats = buffer.stats();
+  EXPECT_EQ(stats.received, 3u);
+  EXPECT_EQ(stats.released, 3u);
+  EXPECT_EQ(stats.reordered, 1u);
+  EXPECT_EQ(stats.lost, 0u);
+}
+
+TEST(jitterCountsLostLateAndDuplicates) {
+  JitterBuffer buffer(intervalConfig());
+  auto start = Clock::now();
+  auto p0 = packet(0);
+  auto p2 = packet(2);
+  EXPECT(buffer.push(p0, start));
+  EXPECT(buffer.push(p2, start + microseconds(4000)));
+  popSeqs(buffer, start + milliseconds(30));
+
+  auto late = packet(1);
+  auto duplicate = packet(2);
+  EXPECT(buffer.push(late, start + milliseconds(31)));
+  EXPECT(buffer.push(duplicate, start + milliseconds(31)));
+  EXPECT(popSeqs(buffer, start + milliseconds(60)).empty());
+
+  auto stats = buffer.stats();
+  EXPECT_EQ(stats.lost, 1u);
+  EXPECT_EQ(stats.late, 1u);
+  EXPECT_EQ(stats.duplicates, 1u);
+}
+
+TEST(jitterSchedulesByTimestamp) {
+  JitterConfig config;
+  config.clockRate = 8000;
+  config.playoutDelayUs = 20000;
+  JitterBuffer buffer(config);
+  auto start = Clock::now();
+  // 160 units at 8 kHz = 20 ms apart
+  auto p0 = packet(0, 1000);
+  auto p1 = packet(1, 1160);
+  EXPECT(buffer.push(p0, start));
+  EXPECT(buffer.push(p1, start + milliseconds(20)));
+
+  auto due = buffer.nextDue();
+  EXPECT(due.has_value());
+  EXPECT(*due == start + milliseconds(20));
+  EXPECT_EQ(popSeqs(buffer, start + milliseconds(20)).size(), 1u);
+  EXPECT(*buffer.nextDue() == start + milliseconds(40));
+}
+
+TEST(jitterRejectsShortPayloads) {
+  JitterBuffer buffer(intervalConfig());
+  Event event{};
+  event.data = "ab";
+  EXPECT(!buffer.push(event, Clock::now()));
+  EXPECT_EQ(buffer.stats().received, 0u);
+}
+
+TEST(jitterRestartsOnLargeJump) {
+  JitterBuffer buffer(intervalConfig());
+  auto start = Clock::now();
+  auto p0 = packet(0);
+  auto far = packet(5000);
+  EXPECT(buffer.push(p0, start));
+  EXPECT(buffer.push(far, start + milliseconds(1)));
+  // The packet from before the restart is flushed straight away
+  auto seqs = popSeqs(buffer, start + milliseconds(1));
+  EXPECT_EQ(seqs.size(), 1u);
+  EXPECT_EQ(seqs[0], 0);
+  EXPECT_EQ(buffer.stats().lost, 0u);
+}
+
+namespace {
+
+// 3000 packets `intervalUs` apart on the sender's clock, with every tenth
+// pair swapped in transit; returns the stats after playout.
+JitterStats runDrifting(uint32_t intervalUs) {
+  JitterBuffer buffer(intervalConfig());
+  auto start = Clock::now();
+  std::vector<Event> out;
+  for (int i = 0; i < 3000; i++) {
+    auto seq = i % 10 == 8 ? i + 1 : i % 10 == 9 ? i - 1 : i;
+    auto now = start + microseconds(static_cast<int64_t>(i) * intervalUs);
+    buffer.pop(now, out);
+    auto event = packet(static_cast<uint16_t>(seq));
+    buffer.push(event, now);
+  }
+  buffer.pop(Clock::time_point::max(), out);
+  return buffer.stats();
+}
+
+} // namespace
+
+TEST(jitterFollowsSlowSenderClock) {
+  auto nominal = runDrifting(2000);
+  EXPECT_EQ(nominal.reordered, 300u);
+  EXPECT_EQ(nominal.lost, 0u);
+
+  // 1% slower than the configured interval
+  auto slow = runDrifting(2020);
+  EXPECT_EQ(slow.reordered, 300u);
+  EXPECT_EQ(slow.lost, 0u);
+  EXPECT_EQ(slow.late, 0u);
+}
+
+TEST(jitterFollowsFastSenderClock) {
+  JitterBuffer buffer(intervalConfig());
+  auto start = Clock::now();
+  std::vector<Event> out;
+  // 1% faster: playout must not drift later than the configured delay
+  for (int i = 0; i < 3000; i++) {
+    auto now = start + microseconds(i * 1980);
+    auto event = packet(static_cast<uint16_t>(i));
+    buffer.push(event, now);
+    auto due = buffer.nextDue();
+    EXPECT(due.has_value());
+    EXPECT(*due <= now + milliseconds(20));
+    buffer.pop(now, out);
+  }
+  EXPECT_EQ(buffer.stats().lost, 0u);
+}
+
+TEST(jitterReanchorsAfterStall) {
+  JitterBuffer buffer(intervalConfig());
+  auto start = Clock::now();
+  std::vector<Event> out;
+  for (int i = 0; i < 200; i++) {
+    auto seq = i % 10 == 8 ? i + 1 : i % 10 == 9 ? i - 1 : i;
+    // Everything from packet 100 on arrives 50 ms later than planned
+    auto stall = i >= 100 ? 50000 : 0;
+    auto now = start + microseconds(i * 2000 + stall);
+    buffer.pop(now, out);
+    auto event = packet(static_cast<uint16_t>(seq));
+    buffer.push(event, now);
+  }
+  buffer.pop(Clock::time_point::max(), out);
+  EXPECT_EQ(buffer.stats().reordered, 20u);
+  EXPECT_EQ(buffer.stats().lost, 0u);
+}
@@ -0,0 +1,28 @@
+// Runs the core's unit tests; pass a substring to run only matching tests.
+//
+//   jsiudp_tests [FILTER]
+
+#include "test-util.h"
+#include "udp-core.h"
+#include <cstring>
+
+int main(int argc, char **argv) {
+  const char *filter = argc > 1 ? argv[1] : "";
+  int failed = 0;
+  int run = 0;
+  for (auto &test : jsiudp::test::registry()) {
+    if (strstr(test.name, filter) == nullptr) {
+      continue;
+    }
+    run++;
+    try {
+      test.run();
+      printf("ok   %s\n", test.name);
+    } catch (const std::exception &e) {
+      failed++;
+      printf("FAIL %s\n     %s\n", test.name, e.what());
+    }
+  }
+  printf("%d/%d passed\n", run - failed, run);
+  return failed == 0 && run > 0 ? 0 : 1;
+}
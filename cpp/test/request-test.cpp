@@ -0,0 +1,99 @@
+#include "test-util.h"
+#include "udp-core.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace jsiudp;
+
+namespace {
+
+// Client, server and a third socket sending lookalike replies, on loopback
+struct Fixture {
+  std::atomic<int> replies{0};
+  std::atomic<int> timeouts{0};
+  UdpCore core{[this](int, Event &&event) {
+    if (event.type == REPLY) {
+      replies++;
+    } else if (event.type == TIMEOUT) {
+      timeouts++;
+    }
+  }};
+  int client = bound();
+  int server = bound();
+  int stranger = bound();
+
+  int bound() {
+    auto id = core.create(4);
+    core.bind(id, 4, "127.0.0.1", 0);
+    return id;
+  }
+
+  int port(int id) { return core.getSockName(id, 4).port; }
+
+  // Waits for the request to settle either way
+  void settle() {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (replies + timeouts == 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  }
+};
+
+RequestOptions tokenAt0() {
+  RequestOptions options;
+  options.tokenLength = 2;
+  options.retries = 0;
+  options.timeoutUs = 50000;
+  return options;
+}
+
+} // namespace
+
+TEST(requestIgnoresReplyFromOtherAddress) {
+  Fixture f;
+  const char data[] = "t1-request";
+  f.core.sendRequest(f.client, 4, "127.0.0.1", f.port(f.server), data,
+                     sizeof(data), tokenAt0());
+  f.core.send(f.stranger, 4, "127.0.0.1", f.port(f.client), data,
+              sizeof(data));
+  f.settle();
+  EXPECT_EQ(f.replies.load(), 0);
+  EXPECT_EQ(f.timeouts.load(), 1);
+}
+
+TEST(requestAcceptsAnySourceWhenAsked) {
+  Fixture f;
+  const char data[] = "t2-request";
+  auto options = tokenAt0();
+  options.anySource = true;
+  f.core.sendRequest(f.client, 4, "127.0.0.1", f.port(f.server), data,
+                     sizeof(data), options);
+  f.core.send(f.stranger, 4, "127.0.0.1", f.port(f.client), data,
+              sizeof(data));
+  f.settle();
+  EXPECT_EQ(f.replies.load(), 1);
+  EXPECT_EQ(f.timeouts.load(), 0);
+}
+
+TEST(requestRejectsEmptyTokenAndZeroTimeout) {
+  Fixture f;
+  const char data[] = "t3-request";
+  auto send = [&](const RequestOptions &options) {
+    try {
+      f.core.sendRequest(f.client, 4, "127.0.0.1", f.port(f.server), data,
+                         sizeof(data), options);
+    } catch (const UdpError &e) {
+      return std::string(e.what());
+    }
+    return std::string();
+  };
+
+  auto empty = tokenAt0();
+  empty.tokenLength = 0;
+  EXPECT_EQ(send(empty), "EINVAL");
+  auto immediate = tokenAt0();
+  immediate.timeoutUs = 0;
+  EXPECT_EQ(send(immediate), "EINVAL");
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace jsiudp {
+namespace test {
+
+// Minimal self-registering test runner, so the core's tests build on any
+// host without pulling in a framework.
+struct TestCase {
+  const char *name;
+  std::function<void()> run;
+};
+
+inline std::vector<TestCase> &registry() {
+  static std::vector<TestCase> tests;
+  return tests;
+}
+
+struct Registration {
+  Registration(const char *name, std::function<void()> run) {
+    registry().push_back({name, std::move(run)});
+  }
+};
+
+class Failure : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+template <typename A, typename B>
+void expectEqual(const A &actual, const B &expected, const char *expression,
+                 const char *file, int line) {
+  if (!(actual == expected)) {
+    std::ostringstream message;
+    message << file << ":" << line << ": " << expression << " is " << actual
+            << ", expected " << expected;
+    throw Failure(message.str());
+  }
+}
+
+} // namespace test
+} // namespace jsiudp
+
+#define TEST(name)                                                             \
+  static void name();                                                          \
+  static jsiudp::test::Registration name##Registration(#name, name);           \
+  static void name()
+
+#define EXPECT(condition)                                                      \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      throw jsiudp::test::Failure(std::string(__FILE__) + ":" +                \
+                                  std::to_string(__LINE__) + ": " +            \
+                                  #condition);                                 \
+    }                                                                          \
+  } while (0)
+
+#define EXPECT_EQ(actual, expected)                                            \
+  jsiudp::test::expectEqual((actual), (expected), #actual, __FILE__, __LINE__)
@@ -0,0 +1,42 @@
+#include "test-util.h"
+#include "timer-queue.h"
+#include <atomic>
+#include <vector>
+
+using namespace jsiudp;
+using std::chrono::milliseconds;
+
+TEST(timersFireInDeadlineOrder) {
+  TimerQueue timers;
+  std::mutex mutex;
+  std::vector<int> fired;
+  auto now = TimerQueue::Clock::now();
+  auto add = [&](int value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    fired.push_back(value);
+  };
+  timers.schedule(now + milliseconds(20), [&] { add(2); });
+  timers.schedule(now + milliseconds(10), [&] { add(1); });
+  std::this_thread::sleep_for(milliseconds(60));
+  std::lock_guard<std::mutex> lock(mutex);
+  EXPECT_EQ(fired.size(), 2u);
+  EXPECT_EQ(fired[0], 1);
+  EXPECT_EQ(fired[1], 2);
+}
+
+TEST(timersCancel) {
+  TimerQueue timers;
+  std::atomic<int> fired{0};
+  auto id = timers.schedule(TimerQueue::Clock::now() + milliseconds(10),
+                            [&] { fired++; });
+  EXPECT(timers.cancel(id));
+  EXPECT(!timers.cancel(id));
+  std::this_thread::sleep_for(milliseconds(30));
+  EXPECT_EQ(fired.load(), 0);
+}
+
+TEST(timersIgnoredAfterStop) {
+  TimerQueue timers;
+  timers.stop();
+  EXPECT_EQ(timers.schedule(TimerQueue::Clock::now(), [] {}), 0u);
+}
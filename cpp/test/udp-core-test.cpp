@@ -0,0 +1,128 @@
+#include "test-util.h"
+#include "udp-core.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace jsiudp;
+
+TEST(coreDeliversLoopbackDatagram) {
+  std::mutex mutex;
+  std::condition_variable cond;
+  int receivedId = -1;
+  std::string received;
+  UdpCore core([&](int id, Event &&event) {
+    if (event.type == MESSAGE) {
+      std::lock_guard<std::mutex> lock(mutex);
+      receivedId = id;
+      received = event.data;
+      cond.notify_one();
+    }
+  });
+  auto server = core.create(4);
+  core.bind(server, 4, "127.0.0.1", 0);
+  auto client = core.create(4);
+  core.send(client, 4, "127.0.0.1", core.getSockName(server, 4).port, "ping",
+            4);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait_for(lock, std::chrono::seconds(2),
+                [&] { return !received.empty(); });
+  EXPECT_EQ(receivedId, server);
+  EXPECT_EQ(received, std::string("ping"));
+}
+
+TEST(coreReportsErrorCodes) {
+  UdpCore core([](int, Event &&) {});
+  auto code = [](auto &&call) {
+    try {
+      call();
+    } catch (const UdpError &e) {
+      return std::string(e.what());
+    }
+    return std::string();
+  };
+  EXPECT_EQ(code([&] { core.create(5); }), std::string("E_INVALID_TYPE"));
+  EXPECT_EQ(code([&] { core.getSockName(42, 4); }), std::string("EBADF"));
+  // Closing an unknown (e.g. already closed) socket is a no-op
+  EXPECT_EQ(code([&] { core.close(42); }), std::string());
+}
+
+TEST(warmSuspendHoldsQueuedEvents) {
+  std::atomic<int> delivered{0};
+  UdpCore core([&](int, Event &&event) {
+    if (event.type == MESSAGE) {
+      delivered++;
+    }
+  });
+  auto server = core.create(4);
+  core.bind(server, 4, "127.0.0.1", 0);
+  auto client = core.create(4);
+  // A high-priority socket throttles the normal lane to one event in flight
+  core.setPriority(client, Priority::High);
+  DeliveryConfig config;
+  config.normalWindow = 1;
+  config.windowTimeoutUs = 10000000;
+  core.setDeliveryConfig(config);
+
+  auto port = core.getSockName(server, 4).port;
+  for (int i = 0; i < 3; i++) {
+    core.send(client, 4, "127.0.0.1", port, "held", 4);
+  }
+  auto waitFor = [&](auto &&done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (!done() && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  };
+  waitFor([&] { return core.getDeliveryStats().normal.depth == 2; });
+  EXPECT_EQ(delivered.load(), 1);
+
+  core.setSuspendMode(SuspendMode::Warm, 64 * 1024);
+  core.suspendAll();
+  // Opening the window must not release queued events into the suspended app
+  core.eventsConsumed(1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(delivered.load(), 1);
+  EXPECT_EQ(core.getDeliveryStats().normal.depth, 0u);
+
+  core.resumeAll();
+  waitFor([&] { return delivered == 2; });
+  core.eventsConsumed(1);
+  waitFor([&] { return delivered == 3; });
+  EXPECT_EQ(delivered.load(), 3);
+}
+
+TEST(suspendModeIsFixedWhileSuspended) {
+  UdpCore core([](int, Event &&) {});
+  core.setSuspendMode(SuspendMode::Warm, 1024);
+  core.suspendAll();
+  std::string code;
+  try {
+    core.setSuspendMode(SuspendMode::Cold, 1024);
+  } catch (const UdpError &e) {
+    code = e.what();
+  }
+  EXPECT_EQ(code, std::string("EBUSY"));
+  core.resumeAll();
+  core.setSuspendMode(SuspendMode::Cold, 1024);
+}
+
+#ifdef SO_BUSY_POLL
+TEST(pollerResetClearsBusyPoll) {
+  UdpCore core([](int, Event &&) {});
+  auto id = core.create(4);
+  core.bind(id, 4, "127.0.0.1", 0);
+  PollerConfig config;
+  config.busyPollUs = 50;
+  core.setPollerConfig(config);
+  // Raising it needs CAP_NET_ADMIN; nothing to reset without it
+  if (core.getOpt(id, SOL_SOCKET, SO_BUSY_POLL) != 50) {
+    return;
+  }
+  core.setPollerConfig(PollerConfig());
+  EXPECT_EQ(core.getOpt(id, SOL_SOCKET, SO_BUSY_POLL).value_or(-1), 0);
+}
+#endif
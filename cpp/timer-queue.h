@@ -0,0 +1,92 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace jsiudp {
+
+// Single native timer thread, started on first use. Callbacks run on that
+// thread without the queue lock held, so they may schedule or cancel.
+class TimerQueue {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  ~TimerQueue() { stop(); }
+
+  uint64_t schedule(Clock::time_point when, std::function<void()> fn) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_stopped) {
+      return 0;
+    }
+    auto id = _nextId++;
+    _timers.emplace(std::make_pair(when, id), std::move(fn));
+    _deadlines[id] = when;
+    if (!_thread.joinable()) {
+      _thread = std::thread(&TimerQueue::run, this);
+    }
+    _cond.notify_one();
+    return id;
+  }
+
+  bool cancel(uint64_t id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _deadlines.find(id);
+    if (it == _deadlines.end()) {
+      return false;
+    }
+    _timers.erase(std::make_pair(it->second, id));
+    _deadlines.erase(it);
+    return true;
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stopped = true;
+      _timers.clear();
+      _deadlines.clear();
+    }
+    _cond.notify_all();
+    if (_thread.joinable() && _thread.get_id() != std::this_thread::get_id()) {
+      _thread.join();
+    }
+  }
+
+private:
+  void run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopped) {
+      if (_timers.empty()) {
+        _cond.wait(lock);
+        continue;
+      }
+      auto it = _timers.begin();
+      if (Clock::now() < it->first.first) {
+        _cond.wait_until(lock, it->first.first);
+        continue;
+      }
+      auto fn = std::move(it->second);
+      _deadlines.erase(it->first.second);
+      _timers.erase(it);
+      lock.unlock();
+      fn();
+      lock.lock();
+    }
+  }
+
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::map<std::pair<Clock::time_point, uint64_t>, std::function<void()>>
+      _timers;
+  std::unordered_map<uint64_t, Clock::time_point> _deadlines;
+  uint64_t _nextId = 1;
+  bool _stopped = false;
+  std::thread _thread;
+};
+
+} // namespace jsiudp
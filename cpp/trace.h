@@ -0,0 +1,231 @@
+#pragma once
+
+// Trace spans and counters around the I/O and dispatch stages, so native
+// work lines up with the JS thread in system traces:
+//
+//   Android  ATrace (Perfetto / systrace, "app" category)
+//   Linux    ftrace trace_marker in the same format (Perfetto "atrace" /
+//            ftrace/print, trace-cmd)
+//   Apple    os_signpost in the Points of Interest log (Instruments)
+//
+// Compiled out unless JSIUDP_TRACE is defined; the macro arguments are not
+// evaluated then. Names must be string literals (os_signpost requires it).
+//
+//   JSIUDP_TRACE_SCOPE("jsiudp poll");          span to the end of the scope
+//   JSIUDP_TRACE_COUNTER("jsiudp queued", n);   value on a counter track
+
+#if defined(JSIUDP_TRACE) && defined(__APPLE__)
+
+#include <os/signpost.h>
+
+namespace jsiudp {
+namespace trace {
+
+inline os_log_t pointsOfInterest() {
+  static os_log_t log =
+      os_log_create("com.mybigday.jsiudp", OS_LOG_CATEGORY_POINTS_OF_INTEREST);
+  return log;
+}
+
+// The interval name has to be a literal at the os_signpost call, so each
+// scope passes in a function that makes the call.
+class Scope {
+public:
+  using Emit = void (*)(os_log_t log, os_signpost_id_t id, bool begin);
+
+  explicit Scope(Emit emit) {
+    if (__builtin_available(iOS 12.0, tvOS 12.0, macOS 10.14, *)) {
+      if (os_signpost_enabled(pointsOfInterest())) {
+        _emit = emit;
+        _id = os_signpost_id_generate(pointsOfInterest());
+        _emit(pointsOfInterest(), _id, true);
+      }
+    }
+  }
+  ~Scope() {
+    if (_emit) {
+      _emit(pointsOfInterest(), _id, false);
+    }
+  }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  Emit _emit = nullptr;
+  os_signpost_id_t _id = 0;
+};
+
+} // namespace trace
+} // namespace jsiudp
+
+#define JSIUDP_TRACE_SCOPE(name)                                               \
+  jsiudp::trace::Scope JSIUDP_TRACE_VAR(__LINE__)(                             \
+      [](os_log_t log, os_signpost_id_t id, bool begin) {                      \
+        if (__builtin_available(iOS 12.0, tvOS 12.0, macOS 10.14, *)) {        \
+          if (begin) {                                                         \
+            os_signpost_interval_begin(log, id, name);                         \
+          } else {                                                             \
+            os_signpost_interval_end(log, id, name);                           \
+          }                                                                    \
+        }                                                                      \
+      })
+#define JSIUDP_TRACE_COUNTER(name, value)                                      \
+  do {                                                                         \
+    if (__builtin_available(iOS 12.0, tvOS 12.0, macOS 10.14, *)) {            \
+      auto log = jsiudp::trace::pointsOfInterest();                            \
+      if (os_signpost_enabled(log)) {                                          \
+        os_signpost_event_emit(log, OS_SIGNPOST_ID_EXCLUSIVE, name, "%lld",    \
+                               static_cast<long long>(value));                 \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+#elif defined(JSIUDP_TRACE) && defined(__linux__)
+
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#if __ANDROID__
+#include <dlfcn.h>
+#endif
+
+namespace jsiudp {
+namespace trace {
+
+#if __ANDROID__
+
+// Looked up at runtime: ATrace_* needs API 23 (counters API 29), below the
+// minimum SDK.
+struct ATraceApi {
+  bool (*isEnabled)() = nullptr;
+  void (*beginSection)(const char *name) = nullptr;
+  void (*endSection)() = nullptr;
+  void (*setCounter)(const char *name, int64_t value) = nullptr;
+
+  ATraceApi() {
+    auto lib = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+    if (!lib) {
+      return;
+    }
+    beginSection = reinterpret_cast<decltype(beginSection)>(
+        dlsym(lib, "ATrace_beginSection"));
+    endSection =
+        reinterpret_cast<decltype(endSection)>(dlsym(lib, "ATrace_endSection"));
+    setCounter =
+        reinterpret_cast<decltype(setCounter)>(dlsym(lib, "ATrace_setCounter"));
+    if (beginSection && endSection) {
+      isEnabled =
+          reinterpret_cast<decltype(isEnabled)>(dlsym(lib, "ATrace_isEnabled"));
+    }
+  }
+};
+
+inline const ATraceApi &atrace() {
+  static ATraceApi api;
+  return api;
+}
+
+inline bool enabled() {
+  auto &api = atrace();
+  return api.isEnabled && api.isEnabled();
+}
+
+inline void begin(const char *name) { atrace().beginSection(name); }
+
+inline void end() { atrace().endSection(); }
+
+inline void counter(const char *name, int64_t value) {
+  auto &api = atrace();
+  if (api.setCounter && enabled()) {
+    api.setCounter(name, value);
+  }
+}
+
+#else
+
+// Events go to the ftrace buffer in the format atrace writes, so Perfetto
+// and trace-cmd parse them the same way. Without write access to tracefs
+// (usually root only) tracing stays off.
+struct TraceMarker {
+  int fd = -1;
+  int pid = 0;
+
+  TraceMarker() {
+    fd = open("/sys/kernel/tracing/trace_marker", O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+      fd = open("/sys/kernel/debug/tracing/trace_marker",
+                O_WRONLY | O_CLOEXEC);
+    }
+    pid = getpid();
+  }
+
+  template <typename... Args> void write(const char *format, Args... args) {
+    char line[128];
+    auto len = snprintf(line, sizeof(line), format, pid, args...);
+    if (len > 0) {
+      auto size = len < static_cast<int>(sizeof(line))
+                      ? static_cast<size_t>(len)
+                      : sizeof(line) - 1;
+      (void)::write(fd, line, size);
+    }
+  }
+};
+
+inline TraceMarker &marker() {
+  static TraceMarker marker;
+  return marker;
+}
+
+inline bool enabled() { return marker().fd >= 0; }
+
+inline void begin(const char *name) { marker().write("B|%d|%s", name); }
+
+inline void end() { marker().write("E|%d"); }
+
+inline void counter(const char *name, int64_t value) {
+  if (enabled()) {
+    marker().write("C|%d|%s|%lld", name, static_cast<long long>(value));
+  }
+}
+
+#endif
+
+// Sections nest per thread, so the scope must end on the thread that began
+// it (as a stack object does).
+class Scope {
+public:
+  explicit Scope(const char *name) : _active(enabled()) {
+    if (_active) {
+      begin(name);
+    }
+  }
+  ~Scope() {
+    if (_active) {
+      end();
+    }
+  }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  bool _active;
+};
+
+} // namespace trace
+} // namespace jsiudp
+
+#define JSIUDP_TRACE_SCOPE(name)                                               \
+  jsiudp::trace::Scope JSIUDP_TRACE_VAR(__LINE__)(name)
+#define JSIUDP_TRACE_COUNTER(name, value)                                      \
+  jsiudp::trace::counter(name, static_cast<int64_t>(value))
+
+#else
+
+#define JSIUDP_TRACE_SCOPE(name) ((void)0)
+#define JSIUDP_TRACE_COUNTER(name, value) ((void)0)
+
+#endif
+
+#define JSIUDP_TRACE_VAR(line) JSIUDP_TRACE_CONCAT(_jsiudpTrace, line)
+#define JSIUDP_TRACE_CONCAT(a, b) a##b
@@ -0,0 +1,2097 @@
+#include "udp-core.h"
+#include "jitter-buffer.h"
+#include "event-lanes.h"
+#include "packet-capture.h"
+#include "trace.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#if !__APPLE__
+#include <sys/syscall.h>
+#endif
+
+#if __APPLE__
+
+#import <ifaddrs.h>
+
+#endif
+
+#ifndef IPV6_ADD_MEMBERSHIP
+#define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
+#define IPV6_DROP_MEMBERSHIP IPV6_LEAVE_GROUP
+#endif
+
+#define MAX_PACK_SIZE 65535
+#define MAX_CONTROL_SIZE 256
+// Charged against the warm-suspend hold for every held event on top of its
+// payload, so empty datagrams and errors can't pile up without limit
+#define HELD_EVENT_OVERHEAD sizeof(Event)
+
+namespace jsiudp {
+
+std::string error_name(int err) {
+  switch (err) {
+  case EACCES:
+    return "EACCES";
+  case EADDRINUSE:
+    return "EADDRINUSE";
+  case EADDRNOTAVAIL:
+    return "EADDRNOTAVAIL";
+  case EAFNOSUPPORT:
+    return "EAFNOSUPPORT";
+  case EAGAIN:
+    return "EAGAIN";
+  case EALREADY:
+    return "EALREADY";
+  case EBADF:
+    return "EBADF";
+  case ECONNREFUSED:
+    return "ECONNREFUSED";
+  case EFAULT:
+    return "EFAULT";
+  case EINPROGRESS:
+    return "EINPROGRESS";
+  case EINTR:
+    return "EINTR";
+  case EISCONN:
+    return "EISCONN";
+  case ENETUNREACH:
+    return "ENETUNREACH";
+  case ENOTSOCK:
+    return "ENOTSOCK";
+  case ETIMEDOUT:
+    return "ETIMEDOUT";
+  case ENOPROTOOPT:
+    return "ENOPROTOOPT";
+  case EINVAL:
+    return "EINVAL";
+  case EDOM:
+    return "EDOM";
+  case ENOMEM:
+    return "ENOMEM";
+  case ENOBUFS:
+    return "ENOBUFS";
+  case EOPNOTSUPP:
+    return "EOPNOTSUPP";
+  case ENETDOWN:
+    return "ENETDOWN";
+  case ECONNABORTED:
+    return "ECONNABORTED";
+  case ECONNRESET:
+    return "ECONNRESET";
+  case ENOTCONN:
+    return "ENOTCONN";
+  case EHOSTUNREACH:
+    return "EHOSTUNREACH";
+  case EPERM:
+    return "EPERM";
+  case EPIPE:
+    return "EPIPE";
+  case ENOENT:
+    return "ENOENT";
+  case EROFS:
+    return "EROFS";
+  case ENOSPC:
+    return "ENOSPC";
+  default:
+    LOGE("unknown error %d", err);
+    return "UNKNOWN";
+  }
+}
+
+#if __APPLE__
+static bool isOptEnabled(int fd, int level, int option) {
+  int value = 0;
+  socklen_t len = sizeof(value);
+  return getsockopt(fd, level, option, &value, &len) == 0 && value != 0;
+}
+#endif
+
+// Only Apple platforms pin sockets to an interface
+int setupIface([[maybe_unused]] int fd,
+               [[maybe_unused]] struct sockaddr_in &addr) {
+#if __APPLE__
+  auto isAny = addr.sin_addr.s_addr == INADDR_ANY;
+  // A wildcard socket with packet info serves every interface; don't pin it
+  if (isAny && isOptEnabled(fd, IPPROTO_IP, IP_RECVPKTINFO)) {
+    return 0;
+  }
+  struct ifaddrs *ifaddr, *ifa;
+  if (getifaddrs(&ifaddr) == -1) {
+    return -1;
+  }
+  auto isLoopback = addr.sin_addr.s_addr == htonl(INADDR_LOOPBACK);
+  for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
+    if (ifa->ifa_addr != NULL && ifa->ifa_addr->sa_family == AF_INET &&
+        !((ifa->ifa_flags & IFF_LOOPBACK) ^ isLoopback) &&
+        (ifa->ifa_flags & IFF_UP) && (ifa->ifa_flags & IFF_RUNNING) &&
+        (isAny || reinterpret_cast<struct sockaddr_in *>(ifa->ifa_addr)
+                          ->sin_addr.s_addr == addr.sin_addr.s_addr)) {
+      auto index = if_nametoindex(ifa->ifa_name);
+      if (setsockopt(fd, IPPROTO_IP, IP_BOUND_IF, &index, sizeof(index)) != 0) {
+        return -1;
+      }
+      LOGI("bound to %s for %d", ifa->ifa_name, fd);
+      break;
+    }
+  }
+  freeifaddrs(ifaddr);
+#endif
+  return 0;
+}
+
+int setupIface([[maybe_unused]] int fd,
+               [[maybe_unused]] struct sockaddr_in6 &addr) {
+#if __APPLE__
+  auto size = sizeof(addr.sin6_addr);
+  auto isAny = memcmp(&(addr.sin6_addr), &in6addr_any, size) == 0;
+  if (isAny && isOptEnabled(fd, IPPROTO_IPV6, IPV6_RECVPKTINFO)) {
+    return 0;
+  }
+  struct ifaddrs *ifaddr, *ifa;
+  if (getifaddrs(&ifaddr) == -1) {
+    return -1;
+  }
+  auto isLoopback = memcmp(&(addr.sin6_addr), &in6addr_loopback, size) == 0;
+  for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
+    if (ifa->ifa_addr != NULL && ifa->ifa_addr->sa_family == AF_INET6 &&
+        !((ifa->ifa_flags & IFF_LOOPBACK) ^ isLoopback) &&
+        (ifa->ifa_flags & IFF_UP) && (ifa->ifa_flags & IFF_RUNNING) &&
+        (isAny ||
+         memcmp(&(addr.sin6_addr),
+                &(reinterpret_cast<struct sockaddr_in6 *>(ifa->ifa_addr)
+                      ->sin6_addr),
+                size) == 0)) {
+      auto index = if_nametoindex(ifa->ifa_name);
+      if (setsockopt(fd, IPPROTO_IPV6, IPV6_BOUND_IF, &index, sizeof(index)) !=
+          0) {
+        return -1;
+      }
+      LOGI("bound to %s for %d", ifa->ifa_name, fd);
+      break;
+    }
+  }
+  freeifaddrs(ifaddr);
+#endif
+  return 0;
+}
+
+// Ask the kernel to report receive-queue drops with every datagram
+// (Linux/Android).
+static void enableDropCounter(int fd) {
+#ifdef SO_RXQ_OVFL
+  int value = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &value, sizeof(value)) != 0) {
+    LOGW("Failed to set SO_RXQ_OVFL: %s", error_name(errno).c_str());
+  }
+#endif
+}
+
+// Zero what the kernel didn't fill in, so AF_UNIX names (which need not be
+// NUL-terminated, or may be missing altogether) format correctly.
+static void clearAddressTail(struct sockaddr_storage &addr, socklen_t len) {
+  if (len < sizeof(addr)) {
+    memset(reinterpret_cast<char *>(&addr) + len, 0, sizeof(addr) - len);
+  }
+}
+
+// Close a socket fd, removing the filesystem name of a bound AF_UNIX
+// socket so its path can be bound again.
+static void closeSocket(int fd) {
+  struct sockaddr_un addr;
+  socklen_t len = sizeof(addr);
+  if (getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr), &len) == 0 &&
+      addr.sun_family == AF_UNIX &&
+      len > offsetof(struct sockaddr_un, sun_path) &&
+      addr.sun_path[0] != '\0') {
+    unlink(addr.sun_path);
+  }
+  ::close(fd);
+}
+
+// The SO_RCVBUF size as set, or -1 with errno set.
+static int getRecvBuffer(int fd) {
+  int bytes = 0;
+  socklen_t len = sizeof(bytes);
+  if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bytes, &len) != 0) {
+    return -1;
+  }
+#if !__APPLE__
+  // Linux reports twice the size that was set, to account for overhead
+  bytes /= 2;
+#endif
+  return bytes;
+}
+
+// Returns the size the kernel actually applied, which is clamped to
+// net.core.rmem_max (kern.ipc.maxsockbuf on Apple platforms).
+static int setRecvBuffer(int fd, int bytes) {
+  if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes)) != 0) {
+    LOGW("Failed to set SO_RCVBUF: %s", error_name(errno).c_str());
+  }
+  auto applied = getRecvBuffer(fd);
+  return applied >= 0 ? applied : bytes;
+}
+
+// Pick up ancillary data enabled on the socket (packet info, TOS, drop
+// counter).
+// `drops` is the kernel's running count of datagrams dropped on the socket;
+// it is only attached once there has been at least one.
+static void readControl(struct msghdr &msg, Event &event, uint32_t &drops) {
+  for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+#ifdef SO_RXQ_OVFL
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+      memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+      continue;
+    }
+#endif
+    if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO) {
+      auto *info = reinterpret_cast<struct in_pktinfo *>(CMSG_DATA(cmsg));
+      auto &local = reinterpret_cast<struct sockaddr_in &>(event.local);
+      local.sin_family = AF_INET;
+      local.sin_addr = info->ipi_addr;
+      event.ifindex = info->ipi_ifindex;
+    } else if (cmsg->cmsg_level == IPPROTO_IPV6 &&
+               cmsg->cmsg_type == IPV6_PKTINFO) {
+      auto *info = reinterpret_cast<struct in6_pktinfo *>(CMSG_DATA(cmsg));
+      auto &local = reinterpret_cast<struct sockaddr_in6 &>(event.local);
+      local.sin6_family = AF_INET6;
+      local.sin6_addr = info->ipi6_addr;
+      event.ifindex = info->ipi6_ifindex;
+    } else if (cmsg->cmsg_level == IPPROTO_IP &&
+               (cmsg->cmsg_type == IP_TOS || cmsg->cmsg_type == IP_RECVTOS)) {
+      // A single byte; Linux tags it IP_TOS, BSDs IP_RECVTOS
+      event.tos = *reinterpret_cast<unsigned char *>(CMSG_DATA(cmsg));
+    } else if (cmsg->cmsg_level == IPPROTO_IPV6 &&
+               cmsg->cmsg_type == IPV6_TCLASS) {
+      int tclass;
+      memcpy(&tclass, CMSG_DATA(cmsg), sizeof(tclass));
+      event.tos = tclass & 0xff;
+    }
+  }
+}
+
+// Back-off for spin loops: a short burst of pause instructions, then yield
+// so a spinning thread can't starve the one it waits on when cores are
+// scarce.
+static inline void cpuRelax(unsigned &spins) {
+  if (++spins > 64) {
+    sched_yield();
+    return;
+  }
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield");
+#endif
+}
+
+// Scheduling an I/O thread started with; options left unset restore it.
+struct ThreadScheduling {
+#if __APPLE__
+  qos_class_t qos;
+#else
+  int nice;
+  cpu_set_t cpus;
+#endif
+};
+
+static ThreadScheduling currentScheduling() {
+  ThreadScheduling scheduling;
+#if __APPLE__
+  scheduling.qos = qos_class_self();
+  if (scheduling.qos == QOS_CLASS_UNSPECIFIED) {
+    scheduling.qos = QOS_CLASS_DEFAULT;
+  }
+#else
+  auto tid = static_cast<id_t>(syscall(SYS_gettid));
+  // -1 is a valid nice value, so errors are told apart through errno
+  errno = 0;
+  scheduling.nice = getpriority(PRIO_PROCESS, tid);
+  if (errno != 0) {
+    scheduling.nice = 0;
+  }
+  if (sched_getaffinity(0, sizeof(scheduling.cpus), &scheduling.cpus) != 0) {
+    CPU_ZERO(&scheduling.cpus);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      CPU_SET(cpu, &scheduling.cpus);
+    }
+  }
+#endif
+  return scheduling;
+}
+
+// Apply priority / affinity to the calling thread.
+static void applyScheduling(const PollerConfig &config) {
+  // Captured on the thread's first call, before anything was changed
+  static thread_local const ThreadScheduling defaults = currentScheduling();
+#if __APPLE__
+  auto qos = defaults.qos;
+  if (config.priority) {
+    auto priority = *config.priority;
+    qos = priority <= -10 ? QOS_CLASS_USER_INTERACTIVE
+          : priority < 0  ? QOS_CLASS_USER_INITIATED
+          : priority == 0 ? QOS_CLASS_DEFAULT
+                          : QOS_CLASS_UTILITY;
+  }
+  if (pthread_set_qos_class_self_np(qos, 0) != 0) {
+    LOGW("Failed to set I/O thread QoS class");
+  }
+#else
+  auto tid = static_cast<id_t>(syscall(SYS_gettid));
+  auto nice = config.priority ? *config.priority : defaults.nice;
+  if (setpriority(PRIO_PROCESS, tid, nice) != 0) {
+    LOGW("Failed to set I/O thread priority: %s", error_name(errno).c_str());
+  }
+  auto set = defaults.cpus;
+  if (!config.cpus.empty()) {
+    CPU_ZERO(&set);
+    for (auto cpu : config.cpus) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    LOGW("Failed to set I/O thread affinity: %s", error_name(errno).c_str());
+  }
+#endif
+}
+
+// Writes 0 as well, so a reset turns busy polling off on existing sockets.
+static void applyBusyPoll([[maybe_unused]] int fd,
+                          [[maybe_unused]] uint32_t busyPollUs) {
+#ifdef SO_BUSY_POLL
+  int value = static_cast<int>(busyPollUs);
+  if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value)) != 0) {
+    LOGW("Failed to set SO_BUSY_POLL: %s", error_name(errno).c_str());
+  }
+#endif
+}
+
+UdpCore::UdpCore(EventHandler handler, DispatchMode mode)
+    : UdpCore(
+          [handler = std::move(handler)](EventBatch &&batch) {
+            for (auto &[id, event] : batch) {
+              handler(id, std::move(event));
+            }
+          },
+          mode) {}
+
+UdpCore::UdpCore(BatchHandler handler, DispatchMode mode)
+    : _handler(std::move(handler)), _dispatchMode(mode),
+      _lanes(std::make_unique<EventLanes>()),
+      _consumerLink(std::make_shared<ConsumerLink>()) {
+  _consumerLink->core = this;
+  // Create self-pipe for waking the poll thread
+  if (pipe(_wakePipe) != 0) {
+    LOGE("Failed to create wake pipe: %s", error_name(errno).c_str());
+  } else {
+    // Set read end to non-blocking for draining
+    fcntl(_wakePipe[0], F_SETFL, fcntl(_wakePipe[0], F_GETFL) | O_NONBLOCK);
+  }
+
+  if (mode == DispatchMode::EventThread) {
+    eventThread = std::thread(&UdpCore::receiveEvent, this);
+  }
+  _pollThread = std::thread(&UdpCore::pollLoop, this);
+}
+
+UdpCore::~UdpCore() {
+  {
+    std::lock_guard<std::recursive_mutex> lock(_consumerLink->mutex);
+    _consumerLink->core = nullptr;
+  }
+  _invalidate = true;
+  _timers.stop();
+  wakePoller();
+  cond.notify_all();
+  if (_pollThread.joinable())
+    _pollThread.join();
+  if (eventThread.joinable())
+    eventThread.join();
+  if (_wakePipe[0] >= 0)
+    ::close(_wakePipe[0]);
+  if (_wakePipe[1] >= 0)
+    ::close(_wakePipe[1]);
+  for (const auto &[id, fd] : idToFdMap) {
+    closeSocket(fd);
+  }
+}
+
+void UdpCore::watchFd(int fd) {
+  if (_invalidate)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(_watchMutex);
+    _watchedFds.insert(fd);
+    // New sockets start with busy polling off
+    if (_pollerConfig.busyPollUs > 0) {
+      applyBusyPoll(fd, _pollerConfig.busyPollUs);
+    }
+  }
+  wakePoller();
+}
+
+void UdpCore::unwatchFd(int fd) {
+  {
+    std::lock_guard<std::mutex> lock(_watchMutex);
+    _watchedFds.erase(fd);
+    _unwatchedFds.push_back(fd);
+  }
+  wakePoller();
+}
+
+void UdpCore::wakePoller() {
+  char c = 1;
+  // Best-effort write; if pipe is full the poller will wake anyway
+  auto unused __attribute__((unused)) = write(_wakePipe[1], &c, 1);
+}
+
+void UdpCore::setPollerConfig(const PollerConfig &config) {
+#if !__APPLE__
+  for (auto cpu : config.cpus) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      throw UdpError("EINVAL");
+    }
+  }
+#endif
+  {
+    std::lock_guard<std::mutex> lock(_watchMutex);
+    if (config.busyPollUs != _pollerConfig.busyPollUs) {
+      for (int fd : _watchedFds) {
+        applyBusyPoll(fd, config.busyPollUs);
+      }
+    }
+    _pollerConfig = config;
+    _spinUs = config.spinUs;
+    _readBudget = config.readBudget;
+    _pollerGeneration++;
+  }
+  // Both I/O threads pick the change up on their next iteration
+  wakePoller();
+  cond.notify_all();
+}
+
+void UdpCore::refreshThreadConfig(unsigned &generation) {
+  if (generation == _pollerGeneration) {
+    return;
+  }
+  PollerConfig config;
+  {
+    std::lock_guard<std::mutex> lock(_watchMutex);
+    config = _pollerConfig;
+    generation = _pollerGeneration;
+  }
+  applyScheduling(config);
+}
+
+bool UdpCore::isHoldFull() {
+  return _suspended && _heldBytes >= _holdCapacity;
+}
+
+void UdpCore::pollLoop() {
+  char buffer[MAX_PACK_SIZE];
+  unsigned generation = 0;
+  auto spinUntil = std::chrono::steady_clock::time_point();
+  unsigned spins = 0;
+  // Last drop counter seen per fd, owned by this thread
+  std::map<int, uint32_t> dropCounters;
+  // Sockets that used up their read budget; they are read again next round
+  // without waiting for poll to report them
+  std::vector<int> carried;
+  std::vector<int> ready;
+
+  while (!_invalidate) {
+    refreshThreadConfig(generation);
+    // Build pollfd array: wake pipe + watched socket fds not carried over
+    std::vector<struct pollfd> pollfds;
+    {
+      std::lock_guard<std::mutex> lock(_watchMutex);
+      pollfds.reserve(_watchedFds.size() + 1);
+      pollfds.push_back({_wakePipe[0], POLLIN, 0});
+      for (int fd : _unwatchedFds) {
+        dropCounters.erase(fd);
+      }
+      _unwatchedFds.clear();
+      // Once the warm-suspend hold is full, leave the rest in the kernel
+      if (isHoldFull()) {
+        carried.clear();
+      } else {
+        carried.erase(std::remove_if(carried.begin(), carried.end(),
+                                     [this](int fd) {
+                                       return _watchedFds.count(fd) == 0;
+                                     }),
+                      carried.end());
+        for (int fd : _watchedFds) {
+          if (std::find(carried.begin(), carried.end(), fd) == carried.end()) {
+            pollfds.push_back({fd, POLLIN, 0});
+          }
+        }
+      }
+    }
+
+    // In low-latency mode keep polling without sleeping for a while after
+    // the last packet; with sockets carried over, only check for new work
+    auto spinning = _spinUs > 0 && std::chrono::steady_clock::now() < spinUntil;
+    int ret;
+    {
+      JSIUDP_TRACE_SCOPE("jsiudp poll");
+      ret = poll(pollfds.data(), static_cast<nfds_t>(pollfds.size()),
+                 spinning || !carried.empty() ? 0 : -1);
+    }
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      LOGE("poll error: %s", error_name(errno).c_str());
+      break;
+    }
+    if (_invalidate)
+      break;
+    if (ret == 0 && carried.empty()) {
+      cpuRelax(spins);
+      continue;
+    }
+    spins = 0;
+    if (_spinUs > 0) {
+      spinUntil = std::chrono::steady_clock::now() +
+                  std::chrono::microseconds(_spinUs.load());
+    }
+
+    // Drain wake pipe if signaled
+    if (pollfds[0].revents & POLLIN) {
+      char dummy[64];
+      while (read(_wakePipe[0], dummy, sizeof(dummy)) > 0) {
+      }
+      // fd set may have changed, will be rebuilt next iteration
+    }
+
+    // Newly ready sockets go first, then the carried ones in the order they
+    // ran out, so a flooded socket delays the others by one budget at most
+    ready.clear();
+    for (size_t i = 1; i < pollfds.size(); i++) {
+      if (pollfds[i].revents & POLLNVAL)
+        continue; // fd was closed, skip
+      if (pollfds[i].revents & POLLIN)
+        ready.push_back(pollfds[i].fd);
+    }
+    ready.insert(ready.end(), carried.begin(), carried.end());
+    carried.clear();
+    JSIUDP_TRACE_COUNTER("jsiudp ready sockets", ready.size());
+
+    auto budget = _readBudget.load();
+    for (int fd : ready) {
+      if (readSocket(fd, budget, buffer, dropCounters)) {
+        carried.push_back(fd);
+      }
+    }
+    // Direct dispatch: hand this round's events over as one batch
+    flushEvents();
+  }
+}
+
+bool UdpCore::readSocket(int fd, uint32_t budget, char *buffer,
+                         std::map<int, uint32_t> &dropCounters) {
+  JSIUDP_TRACE_SCOPE("jsiudp recv");
+  uint32_t count = 0;
+  bool more = false;
+  for (; !_invalidate && !isHoldFull(); count++) {
+    if (budget > 0 && count == budget) {
+      more = true;
+      break;
+    }
+    struct sockaddr_storage src_addr;
+    struct iovec iov = {buffer, MAX_PACK_SIZE};
+    alignas(struct cmsghdr) char control[MAX_CONTROL_SIZE];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &src_addr;
+    msg.msg_namelen = sizeof(src_addr);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    auto recvn = recvmsg(fd, &msg, MSG_DONTWAIT);
+    if (recvn < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break; // No more data
+      if (errno == EBADF)
+        break; // Socket was closed
+      sendEvent({fd, ERROR, error_name(errno), {}});
+      break;
+    }
+    clearAddressTail(src_addr, msg.msg_namelen);
+
+    // Keep the binary address; it is only formatted if JS reads it
+    Event event{fd, MESSAGE, std::string(buffer, recvn), src_addr};
+    uint32_t drops = 0;
+    readControl(msg, event, drops);
+    if (drops != 0) {
+      auto &last = dropCounters[fd];
+      // A smaller count means the fd was reused by a new socket
+      auto dropped = drops >= last ? drops - last : drops;
+      last = drops;
+      if (dropped > 0) {
+        onKernelDrops(fd, dropped);
+      }
+    }
+    if (_capturing) {
+      if (auto capture = std::atomic_load(&_capture)) {
+        capture->record(CaptureDirection::Inbound, fd, event.remote,
+                        event.local, event.tos, buffer, recvn);
+      }
+    }
+    sendEvent(std::move(event));
+  }
+  JSIUDP_TRACE_COUNTER("jsiudp recv batch", count);
+  return more;
+}
+
+std::string formatAddress(const struct sockaddr_storage &addr) {
+  char host[INET6_ADDRSTRLEN] = {0};
+  if (addr.ss_family == AF_INET) {
+    inet_ntop(AF_INET,
+              &reinterpret_cast<const struct sockaddr_in &>(addr).sin_addr,
+              host, sizeof(host));
+  } else if (addr.ss_family == AF_INET6) {
+    inet_ntop(AF_INET6,
+              &reinterpret_cast<const struct sockaddr_in6 &>(addr).sin6_addr,
+              host, sizeof(host));
+  } else if (addr.ss_family == AF_UNIX) {
+    // Abstract names start with a NUL and are shown as "@name"; an unnamed
+    // peer formats as ""
+    auto &path = reinterpret_cast<const struct sockaddr_un &>(addr).sun_path;
+    if (path[0] == '\0') {
+      auto length = strnlen(path + 1, sizeof(path) - 1);
+      return length > 0 ? "@" + std::string(path + 1, length) : "";
+    }
+    return std::string(path, strnlen(path, sizeof(path)));
+  }
+  return host;
+}
+
+int addressPort(const struct sockaddr_storage &addr) {
+  if (addr.ss_family == AF_INET) {
+    return ntohs(reinterpret_cast<const struct sockaddr_in &>(addr).sin_port);
+  } else if (addr.ss_family == AF_INET6) {
+    return ntohs(reinterpret_cast<const struct sockaddr_in6 &>(addr).sin6_port);
+  }
+  return 0;
+}
+
+// Fill `addr` for a destination, returns its length.
+static socklen_t toSockAddr(int type, const std::string &host, int port,
+                            struct sockaddr_storage &addr) {
+  memset(&addr, 0, sizeof(addr));
+  if (type == UNIX_DGRAM) {
+    auto &un = reinterpret_cast<struct sockaddr_un &>(addr);
+    un.sun_family = AF_UNIX;
+    if (host.size() >= sizeof(un.sun_path)) {
+      throw UdpError("ENAMETOOLONG");
+    }
+    memcpy(un.sun_path, host.data(), host.size());
+    if (!host.empty() && host[0] == '@') {
+      un.sun_path[0] = '\0';
+      return static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) +
+                                    host.size());
+    }
+    // An empty path binds to an autogenerated abstract name (Linux)
+    return static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) +
+                                  (host.empty() ? 0 : host.size() + 1));
+  }
+  if (type == 4) {
+    auto &addr4 = reinterpret_cast<struct sockaddr_in &>(addr);
+    addr4.sin_family = AF_INET;
+    addr4.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &(addr4.sin_addr)) != 1) {
+      throw UdpError("EINVAL");
+    }
+    return sizeof(addr4);
+  }
+  auto &addr6 = reinterpret_cast<struct sockaddr_in6 &>(addr);
+  addr6.sin6_family = AF_INET6;
+  addr6.sin6_port = htons(port);
+  if (inet_pton(AF_INET6, host.c_str(), &(addr6.sin6_addr)) != 1) {
+    throw UdpError("EINVAL");
+  }
+  return sizeof(addr6);
+}
+
+int UdpCore::getFdOrThrow(int id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = idToFdMap.find(id);
+  if (it == idToFdMap.end()) {
+    throw UdpError("EBADF");
+  }
+  return it->second;
+}
+
+void UdpCore::closeAll() {
+  std::map<int, int> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    snapshot = idToFdMap;
+    idToFdMap.clear();
+    suspendedSockets.clear();
+    _warmStates.clear();
+    _held.clear();
+    _heldBytes = 0;
+    _suspended = false;
+    for (auto &[id, stage] : _jitterStages) {
+      _timers.cancel(stage.timer);
+    }
+    _jitterStages.clear();
+    _requests.clear();
+    _requestTokens.clear();
+    for (auto &[id, state] : _receiveStates) {
+      _timers.cancel(state.timer);
+    }
+    _receiveStates.clear();
+    _highPriority.clear();
+    _lanes->setThrottled(false);
+    syncQueuedLocked();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_watchMutex);
+    _unwatchedFds.insert(_unwatchedFds.end(), _watchedFds.begin(),
+                         _watchedFds.end());
+    _watchedFds.clear();
+  }
+  wakePoller();
+
+  for (const auto &[id, fd] : snapshot) {
+    forgetCaptured(fd);
+    closeSocket(fd);
+  }
+}
+
+
+int UdpCore::create(int type) {
+  if (type != 4 && type != 6 && type != UNIX_DGRAM) {
+    throw UdpError("E_INVALID_TYPE");
+  }
+
+  auto family = type == 4 ? AF_INET : type == 6 ? AF_INET6 : AF_UNIX;
+
+  auto fd = socket(family, SOCK_DGRAM, 0);
+  if (fd <= 0) {
+    throw UdpError(error_name(errno));
+  }
+
+  // Set non-blocking for poll-based I/O
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  enableDropCounter(fd);
+
+  int id = nextId++;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    idToFdMap[id] = fd;
+  }
+
+  return id;
+}
+
+bool UdpCore::exists(int id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return idToFdMap.count(id) != 0;
+}
+
+void UdpCore::bind(int id, int type, const std::string &host, int port) {
+  auto fd = getFdOrThrow(id);
+
+  long ret = 0;
+  if (type == UNIX_DGRAM) {
+    struct sockaddr_storage addr;
+    auto len = toSockAddr(type, host, port, addr);
+    ret = ::bind(fd, reinterpret_cast<struct sockaddr *>(&addr), len);
+  } else if (type == 4) {
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    ret = inet_pton(AF_INET, host.c_str(), &(addr.sin_addr));
+    if (ret == 1) {
+      if (setupIface(fd, addr) != 0) {
+        throw UdpError(error_name(errno));
+      }
+      ret =
+          ::bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+    }
+  } else {
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(port);
+    ret = inet_pton(AF_INET6, host.c_str(), &(addr.sin6_addr));
+    if (ret == 1) {
+      if (setupIface(fd, addr) != 0) {
+        throw UdpError(error_name(errno));
+      }
+      ret =
+          ::bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+    }
+  }
+
+  if (ret < 0) {
+    throw UdpError(error_name(errno));
+  }
+
+  watchFd(fd);
+}
+
+void UdpCore::close(int id) {
+  int fd;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = idToFdMap.find(id);
+    if (it == idToFdMap.end()) {
+      // Already closed (e.g. by closeAll/suspendAll), treat as no-op
+      return;
+    }
+    fd = it->second;
+    idToFdMap.erase(it);
+    auto stage = _jitterStages.find(id);
+    if (stage != _jitterStages.end()) {
+      _timers.cancel(stage->second.timer);
+      _jitterStages.erase(stage);
+    }
+    dropRequests(id);
+    auto state = _receiveStates.find(id);
+    if (state != _receiveStates.end()) {
+      _timers.cancel(state->second.timer);
+      _receiveStates.erase(state);
+    }
+    if (_highPriority.erase(id) != 0 && _highPriority.empty()) {
+      _lanes->setThrottled(false);
+      syncQueuedLocked();
+    }
+  }
+  unwatchFd(fd);
+  forgetCaptured(fd);
+  closeSocket(fd);
+}
+
+void UdpCore::setOpt(int id, int level, int option, int value) {
+  auto fd = getFdOrThrow(id);
+
+  long result = 0;
+  if (level == SOL_SOCKET) {
+    result = setsockopt(fd, SOL_SOCKET, option, &value, sizeof(value));
+  } else if (level == IPPROTO_IP) {
+    switch (option) {
+    case IP_TTL:
+    case IP_MULTICAST_TTL:
+    case IP_MULTICAST_LOOP:
+    case IP_RECVPKTINFO:
+    case IP_TOS:
+    case IP_RECVTOS:
+      result = setsockopt(fd, IPPROTO_IP, option, &value, sizeof(value));
+      break;
+    default:
+      throw UdpError("E_INVALID_OPTION");
+    }
+  } else if (level == IPPROTO_IPV6) {
+    switch (option) {
+    case IPV6_MULTICAST_HOPS:
+    case IPV6_MULTICAST_LOOP:
+    case IPV6_RECVPKTINFO:
+    case IPV6_TCLASS:
+    case IPV6_RECVTCLASS:
+      result = setsockopt(fd, IPPROTO_IPV6, option, &value, sizeof(value));
+      break;
+    default:
+      throw UdpError("E_INVALID_OPTION");
+    }
+  } else {
+    throw UdpError("E_INVALID_LEVEL");
+  }
+  if (result < 0) {
+    throw UdpError(error_name(errno));
+  }
+}
+
+void UdpCore::setMembership(int id, int level, int option,
+                            const std::string &group,
+                            const std::string &iface) {
+  auto fd = getFdOrThrow(id);
+
+  long result = 0;
+  if (level == IPPROTO_IP) {
+    switch (option) {
+    case IP_ADD_MEMBERSHIP:
+    case IP_DROP_MEMBERSHIP: {
+      struct ip_mreq mreq;
+      mreq.imr_multiaddr.s_addr = inet_addr(group.c_str());
+      if (!iface.empty()) {
+        mreq.imr_interface.s_addr = inet_addr(iface.c_str());
+      } else {
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+      }
+      result = setsockopt(fd, IPPROTO_IP, option, &mreq, sizeof(mreq));
+      LOGD("member of %s", group.c_str());
+      break;
+    }
+    default:
+      throw UdpError("E_INVALID_OPTION");
+    }
+  } else if (level == IPPROTO_IPV6) {
+    switch (option) {
+    case IPV6_ADD_MEMBERSHIP:
+    case IPV6_DROP_MEMBERSHIP: {
+      struct ipv6_mreq mreq;
+      auto ret = inet_pton(AF_INET6, group.c_str(), &(mreq.ipv6mr_multiaddr));
+      if (ret != 1) {
+        throw UdpError(error_name(errno));
+      }
+      // ipv6mr_interface is an interface index; accept "name", "addr%name"
+      // or a numeric index.
+      mreq.ipv6mr_interface = 0;
+      if (!iface.empty()) {
+        auto scope = iface.substr(iface.find('%') + 1);
+        mreq.ipv6mr_interface = if_nametoindex(scope.c_str());
+        if (mreq.ipv6mr_interface == 0) {
+          mreq.ipv6mr_interface =
+              static_cast<unsigned int>(strtoul(scope.c_str(), nullptr, 10));
+        }
+      }
+      result = setsockopt(fd, IPPROTO_IPV6, option, &mreq, sizeof(mreq));
+      break;
+    }
+    default:
+      throw UdpError("E_INVALID_OPTION");
+    }
+  } else {
+    throw UdpError("E_INVALID_LEVEL");
+  }
+  if (result < 0) {
+    throw UdpError(error_name(errno));
+  }
+}
+
+std::optional<int> UdpCore::getOpt(int id, int level, int option) {
+  auto fd = getFdOrThrow(id);
+
+  if (level == IPPROTO_IP) {
+    switch (option) {
+    case IP_TTL:
+    case IP_MULTICAST_TTL:
+    case IP_MULTICAST_LOOP:
+    case IP_RECVPKTINFO:
+    case IP_TOS:
+    case IP_RECVTOS:
+      break;
+    default:
+      return std::nullopt;
+    }
+  } else if (level == IPPROTO_IPV6) {
+    switch (option) {
+    case IPV6_MULTICAST_HOPS:
+    case IPV6_MULTICAST_LOOP:
+    case IPV6_RECVPKTINFO:
+    case IPV6_TCLASS:
+    case IPV6_RECVTCLASS:
+      break;
+    default:
+      return std::nullopt;
+    }
+  } else if (level != SOL_SOCKET) {
+    return std::nullopt;
+  }
+
+  // Some platforms store the multicast options as a single byte
+  uint32_t value = 0;
+  socklen_t len = sizeof(value);
+  auto result = getsockopt(fd, level, option, &value, &len);
+  if (result < 0) {
+    throw UdpError(error_name(errno));
+  }
+  if (len == 1) {
+    return static_cast<int>(*reinterpret_cast<uint8_t *>(&value));
+  }
+  return static_cast<int>(value);
+}
+
+void UdpCore::send(int id, int type, const std::string &host, int port,
+                   const void *data, size_t size,
+                   const SendOptions &options) {
+  auto fd = getFdOrThrow(id);
+
+  struct sockaddr_storage addr;
+  auto addrLen = toSockAddr(type, host, port, addr);
+
+  struct iovec iov = {const_cast<void *>(data), size};
+  alignas(struct cmsghdr) char control[MAX_CONTROL_SIZE];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name = &addr;
+  msg.msg_namelen = addrLen;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  size_t controlLen = 0;
+  auto addControl = [&](int level, int cmsgType, const void *value,
+                        size_t len) {
+    auto *cmsg = reinterpret_cast<struct cmsghdr *>(control + controlLen);
+    memset(cmsg, 0, CMSG_SPACE(len));
+    cmsg->cmsg_level = level;
+    cmsg->cmsg_type = cmsgType;
+    cmsg->cmsg_len = CMSG_LEN(len);
+    memcpy(CMSG_DATA(cmsg), value, len);
+    controlLen += CMSG_SPACE(len);
+  };
+
+  if (type == UNIX_DGRAM &&
+      (!options.sourceAddress.empty() || options.ifindex != 0 ||
+       options.tos >= 0)) {
+    throw UdpError("EINVAL");
+  }
+
+  // Per-datagram source address / interface selection
+  if (!options.sourceAddress.empty() || options.ifindex != 0) {
+    if (type == 4) {
+      struct in_pktinfo info;
+      memset(&info, 0, sizeof(info));
+      info.ipi_ifindex = options.ifindex;
+      if (!options.sourceAddress.empty() &&
+          inet_pton(AF_INET, options.sourceAddress.c_str(),
+                    &info.ipi_spec_dst) != 1) {
+        throw UdpError("EINVAL");
+      }
+      addControl(IPPROTO_IP, IP_PKTINFO, &info, sizeof(info));
+    } else {
+      struct in6_pktinfo info;
+      memset(&info, 0, sizeof(info));
+      info.ipi6_ifindex = options.ifindex;
+      if (!options.sourceAddress.empty() &&
+          inet_pton(AF_INET6, options.sourceAddress.c_str(),
+                    &info.ipi6_addr) != 1) {
+        throw UdpError("EINVAL");
+      }
+      addControl(IPPROTO_IPV6, IPV6_PKTINFO, &info, sizeof(info));
+    }
+  }
+
+  // Per-datagram DSCP / ECN marking
+  if (options.tos >= 0) {
+    if (options.tos > 0xff) {
+      throw UdpError("EINVAL");
+    }
+    if (type == 4) {
+      addControl(IPPROTO_IP, IP_TOS, &options.tos, sizeof(options.tos));
+    } else {
+      addControl(IPPROTO_IPV6, IPV6_TCLASS, &options.tos, sizeof(options.tos));
+    }
+  }
+
+  if (controlLen > 0) {
+    msg.msg_control = control;
+    msg.msg_controllen = controlLen;
+  }
+
+  auto ret = sendmsg(fd, &msg, MSG_DONTWAIT);
+
+  // A full UDP send buffer drops the datagram like the network would; a
+  // full AF_UNIX peer queue is reported so the caller can retry.
+  if (ret < 0 && (type == UNIX_DGRAM ||
+                  (errno != EWOULDBLOCK && errno != EAGAIN))) {
+    throw UdpError(error_name(errno));
+  }
+  if (ret >= 0) {
+    captureSent(fd, addr, data, size, options.tos);
+  }
+}
+
+SockName UdpCore::getSockName(int id, int type) {
+  auto fd = getFdOrThrow(id);
+
+  if (type == UNIX_DGRAM) {
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr), &len) <
+        0) {
+      throw UdpError(error_name(errno));
+    }
+    clearAddressTail(addr, len);
+    return {AF_UNIX, formatAddress(addr), 0};
+  } else if (type == 4) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    auto ret = getsockname(fd, (struct sockaddr *)&addr, &len);
+    if (ret < 0) {
+      throw UdpError(error_name(errno));
+    }
+    char host[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr.sin_addr, host, INET_ADDRSTRLEN);
+    return {AF_INET, host, ntohs(addr.sin_port)};
+  } else {
+    struct sockaddr_in6 addr;
+    socklen_t len = sizeof(addr);
+    auto ret = getsockname(fd, (struct sockaddr *)&addr, &len);
+    if (ret < 0) {
+      throw UdpError(error_name(errno));
+    }
+    char host[INET6_ADDRSTRLEN];
+    inet_ntop(AF_INET6, &addr.sin6_addr, host, INET6_ADDRSTRLEN);
+    return {AF_INET6, host, ntohs(addr.sin6_port)};
+  }
+}
+
+void UdpCore::receiveEvent() {
+  unsigned generation = 0;
+  while (!_invalidate) {
+    refreshThreadConfig(generation);
+    std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+    {
+      JSIUDP_TRACE_SCOPE("jsiudp wait");
+      if (_spinUs > 0 && _queued == 0) {
+        // Low-latency mode: wait for the next event without sleeping, for a
+        // bounded time
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::microseconds(_spinUs.load());
+        unsigned spins = 0;
+        while (_queued == 0 && !_invalidate &&
+               generation == _pollerGeneration &&
+               std::chrono::steady_clock::now() < deadline) {
+          cpuRelax(spins);
+        }
+      }
+      lock.lock();
+      cond.wait(lock, [this, generation] {
+        return _invalidate || _queued > 0 || generation != _pollerGeneration;
+      });
+    }
+    if (_invalidate) {
+      break;
+    }
+    if (_queued == 0) {
+      continue; // Poller config changed
+    }
+    EventBatch batch;
+    takeBatchLocked(batch);
+    lock.unlock();
+    if (!batch.empty()) {
+      dispatch(std::move(batch));
+    }
+  }
+}
+
+// Move what the lanes hand out into `batch`, dropping events of closed
+// sockets.
+void UdpCore::takeBatchLocked(EventBatch &batch) {
+  std::vector<Event> taken;
+  _lanes->take(std::chrono::steady_clock::now(), taken);
+  batch.reserve(taken.size());
+  size_t dropped = 0;
+  for (auto &event : taken) {
+    auto it = std::find_if(
+        idToFdMap.begin(), idToFdMap.end(),
+        [&event](const auto &pair) { return pair.second == event.fd; });
+    if (it != idToFdMap.end()) {
+      batch.emplace_back(it->first, std::move(event));
+    } else if (event.windowed) {
+      dropped++;
+    }
+  }
+  _lanes->consumed(dropped);
+  syncQueuedLocked();
+}
+
+void UdpCore::dispatch(EventBatch &&batch) {
+  JSIUDP_TRACE_SCOPE("jsiudp dispatch");
+  JSIUDP_TRACE_COUNTER("jsiudp dispatch batch", batch.size());
+  _handler(std::move(batch));
+}
+
+void UdpCore::syncQueuedLocked() {
+  _queued = _lanes->ready(std::chrono::steady_clock::now());
+  JSIUDP_TRACE_COUNTER("jsiudp queued", _queued.load());
+  if (_agingTimer == 0) {
+    if (auto aging = _lanes->nextAging()) {
+      _agingTimer = _timers.schedule(*aging, [this] { onAgingTimer(); });
+    }
+  }
+}
+
+void UdpCore::onAgingTimer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    _agingTimer = 0;
+    syncQueuedLocked();
+  }
+  cond.notify_one();
+  flushEvents();
+}
+
+void UdpCore::flushEvents() {
+  if (_dispatchMode != DispatchMode::Direct ||
+      _dispatchingThread == std::this_thread::get_id()) {
+    // Re-entered from the handler; the loop below picks these events up
+    return;
+  }
+  // One thread drains at a time, which serializes handler calls and keeps
+  // batches in order. A thread that finds the lock taken leaves its events
+  // to the holder, which re-checks the queue after unlocking.
+  while (_queued > 0 && !_invalidate) {
+    std::unique_lock<std::mutex> dispatchLock(_dispatchMutex,
+                                              std::try_to_lock);
+    if (!dispatchLock) {
+      return;
+    }
+    EventBatch batch;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      takeBatchLocked(batch);
+    }
+    if (!batch.empty()) {
+      _dispatchingThread = std::this_thread::get_id();
+      dispatch(std::move(batch));
+      _dispatchingThread = std::thread::id();
+    }
+  }
+}
+
+void UdpCore::sendEvent(Event event) {
+  if (_invalidate)
+    return;
+  JSIUDP_TRACE_SCOPE("jsiudp enqueue");
+  std::lock_guard<std::mutex> lock(mutex);
+  if (event.type == MESSAGE &&
+      (!_requests.empty() || !_jitterStages.empty())) {
+    auto it = std::find_if(
+        idToFdMap.begin(), idToFdMap.end(),
+        [&event](const auto &pair) { return pair.second == event.fd; });
+    if (it == idToFdMap.end()) {
+      return; // Socket was closed
+    }
+    auto id = it->first;
+    if (matchReply(id, event)) {
+      return;
+    }
+    auto stage = _jitterStages.find(id);
+    if (stage != _jitterStages.end() &&
+        stage->second.buffer->push(event, TimerQueue::Clock::now())) {
+      armJitter(id, stage->second);
+      return;
+    }
+  }
+  enqueueLocked(std::move(event));
+}
+
+void UdpCore::enqueueLocked(Event &&event) {
+  if (_suspended) {
+    _heldBytes += event.data.size() + HELD_EVENT_OVERHEAD;
+    _held.push_back(std::move(event));
+    return;
+  }
+  pushLocked(std::move(event));
+  syncQueuedLocked();
+  if (_dispatchMode == DispatchMode::EventThread) {
+    cond.notify_one();
+  }
+}
+
+void UdpCore::pushLocked(Event &&event) {
+  if (!_highPriority.empty()) {
+    auto it = std::find_if(
+        idToFdMap.begin(), idToFdMap.end(),
+        [&event](const auto &pair) { return pair.second == event.fd; });
+    if (it != idToFdMap.end() && _highPriority.count(it->first) != 0) {
+      event.priority = Priority::High;
+    }
+  }
+  _lanes->push(std::move(event), std::chrono::steady_clock::now());
+}
+
+void UdpCore::setJitterBuffer(int id,
+                              const std::optional<JitterConfig> &config) {
+  getFdOrThrow(id);
+  if (config && (config->seqBytes == 0 || config->seqBytes > 8 ||
+                 config->timestampBytes == 0 || config->timestampBytes > 8 ||
+                 config->window == 0)) {
+    throw UdpError("EINVAL");
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = _jitterStages.find(id);
+    if (it != _jitterStages.end()) {
+      // Hand over whatever the old stage still holds, in order
+      std::vector<Event> released;
+      it->second.buffer->pop(TimerQueue::Clock::time_point::max(), released);
+      for (auto &event : released) {
+        enqueueLocked(std::move(event));
+      }
+      _timers.cancel(it->second.timer);
+      _jitterStages.erase(it);
+    }
+    if (config) {
+      _jitterStages[id].buffer = std::make_unique<JitterBuffer>(*config);
+    }
+  }
+  flushEvents();
+}
+
+std::optional<JitterStats> UdpCore::getJitterStats(int id) {
+  getFdOrThrow(id);
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = _jitterStages.find(id);
+  if (it == _jitterStages.end()) {
+    return std::nullopt;
+  }
+  return it->second.buffer->stats();
+}
+
+// Called with `mutex` held; keeps a single timer for the earliest playout
+// time, replacing it when an earlier one comes up.
+void UdpCore::armJitter(int id, JitterStage &stage) {
+  auto due = stage.buffer->nextDue();
+  if (!due || (stage.armed && *stage.armed <= *due)) {
+    return;
+  }
+  _timers.cancel(stage.timer);
+  stage.armed = due;
+  stage.timer = _timers.schedule(*due, [this, id] {
+    pumpJitter(id);
+    flushEvents();
+  });
+}
+
+void UdpCore::pumpJitter(int id) {
+  std::vector<Event> released;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = _jitterStages.find(id);
+  if (_invalidate || it == _jitterStages.end()) {
+    return;
+  }
+  // Normally the timer running this; a stale one means a newer is pending
+  _timers.cancel(it->second.timer);
+  it->second.timer = 0;
+  it->second.armed.reset();
+  it->second.buffer->pop(TimerQueue::Clock::now(), released);
+  for (auto &event : released) {
+    enqueueLocked(std::move(event));
+  }
+  armJitter(id, it->second);
+}
+
+uint64_t UdpCore::sendRequest(int id, int type, const std::string &host,
+                              int port, const void *data, size_t size,
+                              const RequestOptions &options) {
+  if (options.tokenLength == 0 ||
+      options.tokenOffset + options.tokenLength > size ||
+      options.retries < 0 || options.backoff < 1 || options.timeoutUs == 0) {
+    throw UdpError("EINVAL");
+  }
+  Transaction txn;
+  txn.socketId = id;
+  txn.destLen = toSockAddr(type, host, port, txn.dest);
+  txn.data.assign(static_cast<const char *>(data), size);
+  txn.key = std::make_tuple(
+      id, options.tokenOffset, options.tokenLength,
+      txn.data.substr(options.tokenOffset, options.tokenLength));
+  txn.anySource = options.anySource;
+  txn.retriesLeft = options.retries;
+  txn.timeout = std::chrono::microseconds(options.timeoutUs);
+  txn.backoff = options.backoff;
+  auto dest = txn.dest;
+  auto destLen = txn.destLen;
+
+  // Register before sending so a quick reply can't be missed, then send
+  // outside the lock like send() does
+  int fd;
+  uint64_t requestId;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = idToFdMap.find(id);
+    if (it == idToFdMap.end()) {
+      throw UdpError("EBADF");
+    }
+    if (_requestTokens.count(txn.key) != 0) {
+      throw UdpError("E_DUPLICATE_TOKEN");
+    }
+    fd = it->second;
+    requestId = _nextRequestId++;
+    txn.timer =
+        _timers.schedule(TimerQueue::Clock::now() + txn.timeout,
+                         [this, requestId] { onRequestTimer(requestId); });
+    _requestTokens[txn.key] = requestId;
+    _requests.emplace(requestId, std::move(txn));
+  }
+
+  auto ret = sendto(fd, data, size, MSG_DONTWAIT,
+                    reinterpret_cast<struct sockaddr *>(&dest), destLen);
+  if (ret < 0 && errno != EWOULDBLOCK && errno != EAGAIN) {
+    auto err = errno;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = _requests.find(requestId);
+    if (it != _requests.end()) {
+      _timers.cancel(it->second.timer);
+      _requestTokens.erase(it->second.key);
+      _requests.erase(it);
+    }
+    throw UdpError(error_name(err));
+  }
+  if (ret >= 0) {
+    captureSent(fd, dest, data, size, -1);
+  }
+  return requestId;
+}
+
+// Same address family, address and port (or AF_UNIX path)
+static bool sameEndpoint(const struct sockaddr_storage &a,
+                         const struct sockaddr_storage &b) {
+  if (a.ss_family != b.ss_family) {
+    return false;
+  }
+  if (a.ss_family == AF_INET) {
+    auto &inA = reinterpret_cast<const struct sockaddr_in &>(a);
+    auto &inB = reinterpret_cast<const struct sockaddr_in &>(b);
+    return inA.sin_port == inB.sin_port &&
+           inA.sin_addr.s_addr == inB.sin_addr.s_addr;
+  }
+  if (a.ss_family == AF_INET6) {
+    auto &in6A = reinterpret_cast<const struct sockaddr_in6 &>(a);
+    auto &in6B = reinterpret_cast<const struct sockaddr_in6 &>(b);
+    return in6A.sin6_port == in6B.sin6_port &&
+           memcmp(&in6A.sin6_addr, &in6B.sin6_addr, sizeof(in6A.sin6_addr)) ==
+               0;
+  }
+  if (a.ss_family == AF_UNIX) {
+    auto &unA = reinterpret_cast<const struct sockaddr_un &>(a);
+    auto &unB = reinterpret_cast<const struct sockaddr_un &>(b);
+    return memcmp(unA.sun_path, unB.sun_path, sizeof(unA.sun_path)) == 0;
+  }
+  return false;
+}
+
+// Called with `mutex` held. Tries every token layout in use on the socket.
+bool UdpCore::matchReply(int id, Event &event) {
+  auto it = _requestTokens.lower_bound(std::make_tuple(id, 0, 0, ""));
+  while (it != _requestTokens.end() && std::get<0>(it->first) == id) {
+    auto offset = std::get<1>(it->first);
+    auto length = std::get<2>(it->first);
+    if (offset + length <= event.data.size()) {
+      auto token = event.data.substr(offset, length);
+      auto match =
+          _requestTokens.find(std::make_tuple(id, offset, length, token));
+      if (match != _requestTokens.end() &&
+          (_requests[match->second].anySource ||
+           sameEndpoint(_requests[match->second].dest, event.remote))) {
+        auto requestId = match->second;
+        _timers.cancel(_requests[requestId].timer);
+        _requests.erase(requestId);
+        _requestTokens.erase(match);
+        event.type = REPLY;
+        event.requestId = requestId;
+        enqueueLocked(std::move(event));
+        return true;
+      }
+    }
+    // Skip to the next token layout
+    it = _requestTokens.lower_bound(
+        std::make_tuple(id, offset, length + 1, ""));
+  }
+  return false;
+}
+
+void UdpCore::onRequestTimer(uint64_t requestId) {
+  retransmit(requestId);
+  flushEvents();
+}
+
+void UdpCore::retransmit(uint64_t requestId) {
+  std::unique_lock<std::mutex> lock(mutex);
+  auto it = _requests.find(requestId);
+  if (_invalidate || it == _requests.end()) {
+    return;
+  }
+  auto &txn = it->second;
+  auto fd = idToFdMap.find(txn.socketId);
+  if (fd == idToFdMap.end()) {
+    // Closed by a cold suspend; wait for the socket to come back
+    txn.timer =
+        _timers.schedule(TimerQueue::Clock::now() + txn.timeout,
+                         [this, requestId] { onRequestTimer(requestId); });
+    return;
+  }
+  if (txn.retriesLeft == 0) {
+    Event event{fd->second, TIMEOUT, {}, txn.dest};
+    event.requestId = requestId;
+    _requestTokens.erase(txn.key);
+    _requests.erase(it);
+    enqueueLocked(std::move(event));
+    return;
+  }
+
+  txn.retriesLeft--;
+  txn.timeout = std::chrono::duration_cast<std::chrono::microseconds>(
+      txn.timeout * txn.backoff);
+  txn.timer =
+      _timers.schedule(TimerQueue::Clock::now() + txn.timeout,
+                       [this, requestId] { onRequestTimer(requestId); });
+  // Send outside the lock; the copy keeps the datagram valid if the request
+  // completes meanwhile
+  auto socket = fd->second;
+  auto data = txn.data;
+  auto dest = txn.dest;
+  auto destLen = txn.destLen;
+  lock.unlock();
+
+  auto ret = sendto(socket, data.data(), data.size(), MSG_DONTWAIT,
+                    reinterpret_cast<struct sockaddr *>(&dest), destLen);
+  if (ret >= 0) {
+    captureSent(socket, dest, data.data(), data.size(), -1);
+  }
+}
+
+// Called with `mutex` held; the socket is going away, so nothing is reported.
+void UdpCore::dropRequests(int id) {
+  for (auto it = _requests.begin(); it != _requests.end();) {
+    if (it->second.socketId == id) {
+      _timers.cancel(it->second.timer);
+      _requestTokens.erase(it->second.key);
+      it = _requests.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// Capture what is needed to recreate a bound socket.
+static bool snapshotSocket(int id, int fd, SocketState &state) {
+  state.id = id;
+
+  struct sockaddr_storage addrStorage;
+  socklen_t len = sizeof(addrStorage);
+  if (getsockname(fd, reinterpret_cast<struct sockaddr *>(&addrStorage),
+                  &len) != 0) {
+    auto error = error_name(errno);
+    LOGW("Failed to snapshot UDP socket %d: %s", id, error.c_str());
+    return false;
+  }
+  clearAddressTail(addrStorage, len);
+  if (addrStorage.ss_family != AF_INET && addrStorage.ss_family != AF_INET6 &&
+      addrStorage.ss_family != AF_UNIX) {
+    LOGW("Unsupported UDP socket family %d for %d", addrStorage.ss_family, id);
+    return false;
+  }
+
+  state.address = formatAddress(addrStorage);
+  state.port = addressPort(addrStorage);
+  state.type = addrStorage.ss_family == AF_INET    ? 4
+               : addrStorage.ss_family == AF_INET6 ? 6
+                                                   : UNIX_DGRAM;
+
+  int value;
+  socklen_t optlen = sizeof(value);
+  if (getsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &value, &optlen) == 0) {
+    state.reuseAddr = value;
+  }
+  if (getsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &value, &optlen) == 0) {
+    state.reusePort = value;
+  }
+  if (getsockopt(fd, SOL_SOCKET, SO_BROADCAST, &value, &optlen) == 0) {
+    state.broadcast = value;
+  }
+  return true;
+}
+
+// Recreate and rebind a socket from its snapshot, returns the new fd or -1.
+static int restoreSocket(const SocketState &state) {
+  auto family = state.type == 4   ? AF_INET
+                : state.type == 6 ? AF_INET6
+                                  : AF_UNIX;
+  auto newFd = socket(family, SOCK_DGRAM, 0);
+  if (newFd <= 0) {
+    auto error = error_name(errno);
+    LOGW("Failed to recreate UDP socket %d: %s", state.id, error.c_str());
+    return -1;
+  }
+
+  // Set non-blocking for poll-based I/O
+  fcntl(newFd, F_SETFL, fcntl(newFd, F_GETFL, 0) | O_NONBLOCK);
+  enableDropCounter(newFd);
+
+  if (state.reuseAddr) {
+    int value = 1;
+    setsockopt(newFd, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value));
+  }
+  if (state.reusePort) {
+    int value = 1;
+    setsockopt(newFd, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value));
+  }
+  if (state.broadcast) {
+    int value = 1;
+    setsockopt(newFd, SOL_SOCKET, SO_BROADCAST, &value, sizeof(value));
+  }
+
+  int ret = -1;
+  if (state.type == UNIX_DGRAM) {
+    struct sockaddr_storage addr;
+    auto len = toSockAddr(state.type, state.address, 0, addr);
+    ret = ::bind(newFd, reinterpret_cast<struct sockaddr *>(&addr), len);
+  } else if (state.type == 4) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(state.port);
+    inet_pton(AF_INET, state.address.c_str(), &(addr.sin_addr));
+
+    if (setupIface(newFd, addr) == 0) {
+      ret = ::bind(newFd, reinterpret_cast<struct sockaddr *>(&addr),
+                   sizeof(addr));
+    }
+  } else {
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(state.port);
+    inet_pton(AF_INET6, state.address.c_str(), &(addr.sin6_addr));
+
+    if (setupIface(newFd, addr) == 0) {
+      ret = ::bind(newFd, reinterpret_cast<struct sockaddr *>(&addr),
+                   sizeof(addr));
+    }
+  }
+
+  if (ret != 0) {
+    auto error = error_name(errno);
+    LOGW("Failed to restore UDP socket %d: %s", state.id, error.c_str());
+    ::close(newFd);
+    return -1;
+  }
+  return newFd;
+}
+
+// A socket kept open across a warm suspend may have been reclaimed by the OS
+// (iOS marks such sockets defunct); those are rebound from their snapshot.
+static bool isSocketUsable(int fd) {
+  int error = 0;
+  socklen_t len = sizeof(error);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0) {
+    return false;
+  }
+  struct sockaddr_storage addr;
+  socklen_t addrLen = sizeof(addr);
+  return error == 0 &&
+         getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                     &addrLen) == 0;
+}
+
+void UdpCore::setSuspendMode(SuspendMode mode, size_t holdBytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  // Fixed from suspendAll until resumeAll
+  if (_suspended || !suspendedSockets.empty()) {
+    throw UdpError("EBUSY");
+  }
+  _suspendMode = mode;
+  _holdCapacity = holdBytes;
+}
+
+void UdpCore::suspendAll() {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (_suspendMode == SuspendMode::Warm) {
+    if (_suspended) {
+      return;
+    }
+    // Keep fds bound; delivery is paused and incoming traffic is held (up to
+    // the cap) until resumeAll. Snapshots are only used as a fallback.
+    _warmStates.clear();
+    for (const auto &[id, fd] : idToFdMap) {
+      SocketState state{};
+      if (snapshotSocket(id, fd, state)) {
+        _warmStates[id] = std::move(state);
+      }
+    }
+    // Events not yet handed out wait for resume too, ahead of the traffic
+    // held from now on
+    std::vector<Event> queued;
+    _lanes->drain(queued);
+    for (auto &event : queued) {
+      _heldBytes += event.data.size() + HELD_EVENT_OVERHEAD;
+      _held.push_back(std::move(event));
+    }
+    syncQueuedLocked();
+    _suspended = true;
+    lock.unlock();
+    wakePoller();
+    return;
+  }
+
+  auto snapshot = idToFdMap;
+  idToFdMap.clear();
+  lock.unlock();
+
+  {
+    std::lock_guard<std::mutex> watchLock(_watchMutex);
+    _unwatchedFds.insert(_unwatchedFds.end(), _watchedFds.begin(),
+                         _watchedFds.end());
+    _watchedFds.clear();
+  }
+  wakePoller();
+
+  if (snapshot.empty()) {
+    return;
+  }
+
+  std::vector<SocketState> nextSuspendedSockets;
+  nextSuspendedSockets.reserve(snapshot.size());
+
+  for (const auto &[id, fd] : snapshot) {
+    SocketState state{};
+    if (snapshotSocket(id, fd, state)) {
+      nextSuspendedSockets.push_back(std::move(state));
+    }
+    forgetCaptured(fd);
+    closeSocket(fd);
+  }
+
+  lock.lock();
+  suspendedSockets.insert(suspendedSockets.end(), nextSuspendedSockets.begin(),
+                          nextSuspendedSockets.end());
+  lock.unlock();
+
+  cond.notify_all();
+}
+
+void UdpCore::resumeAll() {
+  resumeWarm();
+
+  std::vector<SocketState> states;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    states.swap(suspendedSockets);
+  }
+
+  std::vector<std::pair<int, int>> reopenedSockets;
+  reopenedSockets.reserve(states.size());
+
+  for (const auto &state : states) {
+    auto newFd = restoreSocket(state);
+    if (newFd >= 0) {
+      reopenedSockets.emplace_back(state.id, newFd);
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &[id, fd] : reopenedSockets) {
+      idToFdMap[id] = fd;
+    }
+  }
+
+  for (const auto &socket : reopenedSockets) {
+    watchFd(socket.second);
+  }
+}
+
+void UdpCore::resumeWarm() {
+  std::map<int, SocketState> states;
+  std::map<int, int> sockets;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!_suspended) {
+      return;
+    }
+    states.swap(_warmStates);
+    sockets = idToFdMap;
+  }
+
+  // Fall back to close/rebind for sockets that did not survive
+  std::vector<std::pair<int, int>> replaced;
+  // Old fd to new (-1 if the rebind failed), for the held events
+  std::map<int, int> fdMoves;
+  for (const auto &[id, fd] : sockets) {
+    if (isSocketUsable(fd)) {
+      continue;
+    }
+    auto state = states.find(id);
+    LOGW("UDP socket %d did not survive suspend, rebinding", id);
+    unwatchFd(fd);
+    forgetCaptured(fd);
+    closeSocket(fd);
+    auto newFd = state != states.end() ? restoreSocket(state->second) : -1;
+    replaced.emplace_back(id, newFd);
+    fdMoves[fd] = newFd;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &[id, fd] : replaced) {
+      if (fd >= 0) {
+        idToFdMap[id] = fd;
+      } else {
+        idToFdMap.erase(id);
+      }
+    }
+    // Release held traffic ahead of anything read after this point. The old
+    // fd of a rebound socket may already belong to another one, so every
+    // event is mapped from the fd it was read on.
+    for (auto &event : _held) {
+      auto move = fdMoves.find(event.fd);
+      if (move != fdMoves.end()) {
+        event.fd = move->second;
+      }
+      pushLocked(std::move(event));
+    }
+    _held.clear();
+    _heldBytes = 0;
+    _suspended = false;
+    syncQueuedLocked();
+  }
+  cond.notify_one();
+  flushEvents();
+
+  for (const auto &[id, fd] : replaced) {
+    if (fd >= 0) {
+      watchFd(fd);
+    }
+  }
+  wakePoller();
+}
+
+DropStats UdpCore::getDropStats(int id) {
+  auto fd = getFdOrThrow(id);
+  DropStats stats;
+#ifdef SO_RXQ_OVFL
+  stats.supported = true;
+#endif
+  socklen_t len = sizeof(stats.recvBufferSize);
+  if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &stats.recvBufferSize, &len) != 0) {
+    throw UdpError(error_name(errno));
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = _receiveStates.find(id);
+  if (it != _receiveStates.end()) {
+    stats.drops = it->second.drops;
+  }
+  return stats;
+}
+
+void UdpCore::setRecvBufferTuning(
+    int id, const std::optional<RecvBufferTuning> &tuning) {
+  auto fd = getFdOrThrow(id);
+#ifndef SO_RXQ_OVFL
+  // Without drop reports there is nothing to tune on
+  if (tuning) {
+    throw UdpError("EOPNOTSUPP");
+  }
+#endif
+  if (tuning && (tuning->maxBytes <= 0 || tuning->minBytes < 0 ||
+                 tuning->quietMs == 0 ||
+                 tuning->minBytes > tuning->maxBytes)) {
+    throw UdpError("EINVAL");
+  }
+
+  auto current = tuning ? getRecvBuffer(fd) : 0;
+  if (current < 0) {
+    throw UdpError(error_name(errno));
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto &state = _receiveStates[id];
+  _timers.cancel(state.timer);
+  state.timer = 0;
+  state.tuning = tuning;
+  if (!tuning) {
+    return;
+  }
+  state.floorBytes = tuning->minBytes > 0
+                         ? tuning->minBytes
+                         : std::min(current, tuning->maxBytes);
+  state.ceilingBytes = tuning->maxBytes;
+  state.bufferBytes = std::clamp(current, state.floorBytes, tuning->maxBytes);
+  if (state.bufferBytes != current) {
+    auto wanted = state.bufferBytes;
+    state.bufferBytes = setRecvBuffer(fd, wanted);
+    if (state.bufferBytes < wanted) {
+      state.ceilingBytes = state.bufferBytes;
+    }
+  }
+  state.dropsAtCheck = state.drops;
+  state.timer =
+      _timers.schedule(TimerQueue::Clock::now() +
+                           std::chrono::milliseconds(tuning->quietMs),
+                       [this, id] { checkRecvBuffer(id); });
+}
+
+// Runs on the poll thread when a socket's drop counter moves.
+void UdpCore::onKernelDrops(int fd, uint32_t count) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it =
+      std::find_if(idToFdMap.begin(), idToFdMap.end(),
+                   [fd](const auto &entry) { return entry.second == fd; });
+  if (it == idToFdMap.end()) {
+    return;
+  }
+  auto &state = _receiveStates[it->first];
+  state.drops += count;
+  if (!state.tuning || state.bufferBytes >= state.ceilingBytes) {
+    return;
+  }
+  // Give the kernel a moment to drain into the bigger buffer before growing
+  // again, so one burst doesn't jump straight to the cap
+  auto now = std::chrono::steady_clock::now();
+  if (now - state.lastGrow < std::chrono::milliseconds(100)) {
+    return;
+  }
+  state.lastGrow = now;
+  auto wanted = static_cast<int>(std::min<int64_t>(
+      int64_t(state.bufferBytes) * 2, state.ceilingBytes));
+  state.bufferBytes = setRecvBuffer(fd, wanted);
+  // Clamped by the system limit; asking again won't get more
+  if (state.bufferBytes < wanted) {
+    state.ceilingBytes = state.bufferBytes;
+  }
+  LOGD("socket %d: SO_RCVBUF grown to %d", it->first, state.bufferBytes);
+}
+
+// Shrinks the buffer of a tuned socket that saw no drops for a quiet period.
+void UdpCore::checkRecvBuffer(int id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = _receiveStates.find(id);
+  auto fd = idToFdMap.find(id);
+  if (it == _receiveStates.end() || !it->second.tuning ||
+      fd == idToFdMap.end()) {
+    return;
+  }
+  auto &state = it->second;
+  if (state.drops == state.dropsAtCheck &&
+      state.bufferBytes > state.floorBytes) {
+    auto wanted = std::max(state.bufferBytes / 2, state.floorBytes);
+    state.bufferBytes = setRecvBuffer(fd->second, wanted);
+    // Rounded up to the kernel's minimum; no point shrinking further
+    if (state.bufferBytes > wanted) {
+      state.floorBytes = state.bufferBytes;
+    }
+    LOGD("socket %d: SO_RCVBUF shrunk to %d", id, state.bufferBytes);
+  }
+  state.dropsAtCheck = state.drops;
+  state.timer =
+      _timers.schedule(TimerQueue::Clock::now() +
+                           std::chrono::milliseconds(state.tuning->quietMs),
+                       [this, id] { checkRecvBuffer(id); });
+}
+
+void UdpCore::setPriority(int id, Priority priority) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (idToFdMap.count(id) == 0) {
+      throw UdpError("EBADF");
+    }
+    if (priority == Priority::High) {
+      _highPriority.insert(id);
+    } else {
+      _highPriority.erase(id);
+    }
+    // Already queued events stay in their lane
+    _lanes->setThrottled(!_highPriority.empty());
+    syncQueuedLocked();
+  }
+  cond.notify_one();
+  flushEvents();
+}
+
+void UdpCore::setDeliveryConfig(const DeliveryConfig &config) {
+  if (config.windowTimeoutUs == 0) {
+    throw UdpError("EINVAL");
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    _lanes->setConfig(config);
+    if (_agingTimer != 0) {
+      // Re-armed below for the new timeout
+      _timers.cancel(_agingTimer);
+      _agingTimer = 0;
+    }
+    syncQueuedLocked();
+  }
+  cond.notify_one();
+  flushEvents();
+}
+
+DeliveryStats UdpCore::getDeliveryStats(bool reset) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return _lanes->stats(reset);
+}
+
+void UdpCore::eventsConsumed(size_t count) {
+  if (count == 0) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    _lanes->consumed(count);
+    syncQueuedLocked();
+  }
+  if (_queued > 0) {
+    cond.notify_one();
+    flushEvents();
+  }
+}
+
+std::function<void(size_t)> UdpCore::consumer() {
+  return [link = _consumerLink](size_t count) {
+    std::lock_guard<std::recursive_mutex> lock(link->mutex);
+    if (link->core) {
+      link->core->eventsConsumed(count);
+    }
+  };
+}
+
+void UdpCore::startCapture(const std::string &path,
+                           const CaptureConfig &config) {
+  auto capture = std::make_shared<PacketCapture>(path, config);
+  auto previous = std::atomic_exchange(&_capture, capture);
+  _capturing = true;
+  if (previous) {
+    previous->finish();
+  }
+}
+
+std::optional<CaptureStats> UdpCore::stopCapture() {
+  _capturing = false;
+  auto capture =
+      std::atomic_exchange(&_capture, std::shared_ptr<PacketCapture>());
+  if (!capture) {
+    return std::nullopt;
+  }
+  // An I/O thread still holding it gets its record ignored
+  capture->finish();
+  return capture->stats();
+}
+
+void UdpCore::captureSent(int fd, const struct sockaddr_storage &dest,
+                          const void *data, size_t size, int tos) {
+  if (_capturing) {
+    if (auto capture = std::atomic_load(&_capture)) {
+      struct sockaddr_storage local;
+      memset(&local, 0, sizeof(local));
+      capture->record(CaptureDirection::Outbound, fd, dest, local, tos, data,
+                      size);
+    }
+  }
+}
+
+void UdpCore::forgetCaptured(int fd) {
+  if (_capturing) {
+    if (auto capture = std::atomic_load(&_capture)) {
+      capture->forget(fd);
+    }
+  }
+}
+
+} // namespace jsiudp
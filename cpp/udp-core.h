@@ -0,0 +1,464 @@
+#pragma once
+
+#if __APPLE__
+// Expose the RFC 3542 IPV6_RECVPKTINFO/IPV6_PKTINFO API
+#define __APPLE_USE_RFC_3542 1
+#endif
+
+#include "log.h"
+#include "timer-queue.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#ifndef IP_RECVPKTINFO
+// Linux enables IPv4 packet info with IP_PKTINFO itself
+#define IP_RECVPKTINFO IP_PKTINFO
+#endif
+
+namespace jsiudp {
+// Socket type for an AF_UNIX datagram socket, next to 4 / 6 for UDP. Its
+// address is a filesystem path, or "@name" for the Linux abstract namespace;
+// ports are ignored.
+constexpr int UNIX_DGRAM = 1;
+
+enum EventType { MESSAGE, ERROR, CLOSE, REPLY, TIMEOUT };
+
+// Delivery lane of a socket's events. High-priority events are handed to the
+// handler ahead of queued normal ones.
+enum class Priority { Normal, High };
+
+struct Event {
+  int fd;
+  EventType type;
+  std::string data;
+  struct sockaddr_storage remote;
+  // Destination address and arrival interface; only set when packet info
+  // (IP_PKTINFO / IPV6_RECVPKTINFO) is enabled on the socket.
+  struct sockaddr_storage local = {};
+  unsigned int ifindex = 0;
+  // Set on REPLY / TIMEOUT, the id returned by sendRequest
+  uint64_t requestId = 0;
+  // TOS / traffic class byte (DSCP << 2 | ECN); -1 unless IP_RECVTOS /
+  // IPV6_RECVTCLASS is enabled on the socket.
+  int tos = -1;
+  // Lane the event was queued in
+  Priority priority = Priority::Normal;
+  // Counted against the normal window when handed out; only these are
+  // reported back through UdpCore::eventsConsumed.
+  bool windowed = false;
+};
+
+struct SendOptions {
+  // Source address / outgoing interface for this datagram, empty / 0 to
+  // let the kernel choose.
+  std::string sourceAddress;
+  unsigned int ifindex = 0;
+  // TOS / traffic class byte for this datagram, -1 for the socket's own
+  int tos = -1;
+};
+
+struct RequestOptions {
+  // Where the token sits in the request and in its reply; the token must
+  // not be empty
+  size_t tokenOffset = 0;
+  size_t tokenLength = 0;
+  // Accept a reply from any address instead of only from the one the
+  // request went to (e.g. for broadcast / multicast requests)
+  bool anySource = false;
+  // Retransmissions after the first send
+  int retries = 4;
+  // Wait before the first retransmission; must not be 0
+  uint32_t timeoutUs = 2000000;
+  // Applied to the timeout after every retransmission
+  double backoff = 2;
+};
+
+// Native reorder/playout stage for RTP-style streams. Fields are read
+// big-endian from the payload at the given offsets.
+struct JitterConfig {
+  size_t seqOffset = 2;
+  size_t seqBytes = 2;
+  // -1 when the payload has no timestamp field
+  int timestampOffset = 4;
+  size_t timestampBytes = 4;
+  // Timestamp units per second; 0 schedules by sequence number instead
+  uint32_t clockRate = 0;
+  // Spacing between consecutive sequence numbers when clockRate is 0; 0
+  // releases each packet playoutDelayUs after it arrived, in order.
+  uint32_t packetIntervalUs = 0;
+  uint32_t playoutDelayUs = 40000;
+  // Maximum packets held and how far apart sequence numbers may be before
+  // the stream is treated as restarted.
+  size_t window = 64;
+};
+
+struct JitterStats {
+  uint64_t received = 0;
+  uint64_t released = 0;
+  // Sequence numbers skipped at playout time
+  uint64_t lost = 0;
+  // Arrived behind a higher sequence number but in time for playout
+  uint64_t reordered = 0;
+  // Arrived after its slot was played out (also counted as lost)
+  uint64_t late = 0;
+  uint64_t duplicates = 0;
+};
+
+// Opt-in SO_RCVBUF tuning driven by kernel drop reports (SO_RXQ_OVFL).
+struct RecvBufferTuning {
+  // Bounds in bytes; minBytes 0 uses the size the socket had when tuning
+  // was enabled.
+  int minBytes = 0;
+  int maxBytes = 4 * 1024 * 1024;
+  // Halve the buffer after this long without drops
+  uint32_t quietMs = 10000;
+};
+
+struct DropStats {
+  // Datagrams the kernel dropped because the receive buffer was full; only
+  // counted where SO_RXQ_OVFL exists (Linux/Android).
+  uint64_t drops = 0;
+  bool supported = false;
+  // SO_RCVBUF as reported by the kernel
+  int recvBufferSize = 0;
+};
+
+// Trades CPU for latency on the poll and event threads.
+struct PollerConfig {
+  // Keep checking for work this long after the last packet before going to
+  // sleep; 0 always blocks.
+  uint32_t spinUs = 0;
+  // SO_BUSY_POLL budget for every socket (Linux); 0 turns it off.
+  uint32_t busyPollUs = 0;
+  // Nice value for the I/O threads (a QoS class on Apple platforms); unset
+  // restores the one they started with.
+  std::optional<int> priority;
+  // CPUs the I/O threads may run on (Linux/Android); empty restores the
+  // affinity they started with.
+  std::vector<int> cpus;
+  // Datagrams read from one socket before moving on to the next ready one;
+  // a socket with more waiting is read again next round, after the others.
+  // 0 reads each socket until it is empty.
+  uint32_t readBudget = 32;
+};
+
+// Limits how far normal-priority events can run ahead of high-priority ones
+// in the consumer's own queue (e.g. the JS thread). Only applies while some
+// socket has high priority. High-priority traffic never uses up the window,
+// so the normal lane keeps moving however busy the high one is.
+struct DeliveryConfig {
+  // Windowed events (Event::windowed) handed to the handler and not yet
+  // reported back through UdpCore::eventsConsumed; 0 doesn't limit them.
+  size_t normalWindow = 64;
+  // Reopen a full window if nothing was reported consumed for this long,
+  // e.g. because a consumer went away with events unreported.
+  uint32_t windowTimeoutUs = 100000;
+};
+
+struct LaneStats {
+  // Events waiting in the lane now, and the most seen at once
+  size_t depth = 0;
+  size_t maxDepth = 0;
+  uint64_t delivered = 0;
+  // Time from being queued to being handed to the handler
+  uint64_t avgWaitUs = 0;
+  uint64_t maxWaitUs = 0;
+};
+
+struct DeliveryStats {
+  LaneStats high;
+  LaneStats normal;
+  // Normal events counted against the window
+  size_t inFlight = 0;
+};
+
+// Opt-in pcapng recording of every datagram sent and received on IP
+// sockets (AF_UNIX traffic is not captured).
+struct CaptureConfig {
+  // Payload bytes kept per datagram; 0 keeps whole datagrams
+  size_t snapLen = 0;
+  // Records waiting for the writer thread beyond this are dropped; each
+  // counts its kept payload plus its fixed-size header
+  size_t bufferBytes = 4 * 1024 * 1024;
+};
+
+struct CaptureStats {
+  uint64_t packets = 0;
+  uint64_t bytes = 0;
+  // Not written because the buffer was full or the file failed
+  uint64_t dropped = 0;
+};
+
+enum class CaptureDirection { Inbound, Outbound };
+
+struct SocketState {
+  int id;
+  std::string address;
+  int port;
+  int type;
+  bool reuseAddr;
+  bool reusePort;
+  bool broadcast;
+};
+
+struct SockName {
+  int family;
+  std::string address;
+  int port;
+};
+
+enum class SuspendMode {
+  // Close every socket and rebind it on resume
+  Cold,
+  // Keep sockets bound and hold incoming traffic until resume
+  Warm,
+};
+
+// Thrown by UdpCore with an error code such as "EBADF" or "E_INVALID_OPTION".
+class UdpError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+std::string error_name(int err);
+std::string formatAddress(const struct sockaddr_storage &addr);
+int addressPort(const struct sockaddr_storage &addr);
+
+class JitterBuffer;
+class EventLanes;
+class PacketCapture;
+
+// Events tagged with their socket id, in arrival order.
+using EventBatch = std::vector<std::pair<int, Event>>;
+
+enum class DispatchMode {
+  // A dedicated event thread takes events off a queue and calls the handler
+  EventThread,
+  // The thread that produced the events (poll, timer or caller) calls the
+  // handler with them in batches, skipping the hop through the event thread.
+  // Calls are serialized, so the handler must not block.
+  Direct,
+};
+
+// Runtime-agnostic socket table and poll-based I/O engine. Events are
+// delivered to the handler given at construction, keyed by socket id.
+class UdpCore {
+public:
+  using EventHandler = std::function<void(int id, Event &&event)>;
+  using BatchHandler = std::function<void(EventBatch &&batch)>;
+
+  explicit UdpCore(EventHandler handler,
+                   DispatchMode mode = DispatchMode::EventThread);
+  UdpCore(BatchHandler handler, DispatchMode mode);
+  ~UdpCore();
+
+  int create(int type);
+  bool exists(int id);
+  void bind(int id, int type, const std::string &host, int port);
+  void send(int id, int type, const std::string &host, int port,
+            const void *data, size_t size,
+            const SendOptions &options = SendOptions());
+  // Send a request and retransmit it on native timers until a message with
+  // the same token arrives on the socket or retries run out. The outcome is
+  // delivered once, as a REPLY or TIMEOUT event tagged with the returned id.
+  uint64_t sendRequest(int id, int type, const std::string &host, int port,
+                       const void *data, size_t size,
+                       const RequestOptions &options);
+  void close(int id);
+  void setOpt(int id, int level, int option, int value);
+  void setMembership(int id, int level, int option, const std::string &group,
+                     const std::string &iface);
+  std::optional<int> getOpt(int id, int level, int option);
+  SockName getSockName(int id, int type);
+
+  void closeAll();
+  void suspendAll();
+  void resumeAll();
+  // holdBytes caps traffic buffered natively during a warm suspend, counting
+  // a fixed overhead per datagram; anything beyond it is left to the kernel
+  // receive buffer. Throws EBUSY between suspendAll and resumeAll.
+  void setSuspendMode(SuspendMode mode, size_t holdBytes);
+  // Pass a socket's messages through a reorder/playout stage, or remove it
+  // (releasing whatever it holds) with std::nullopt.
+  void setJitterBuffer(int id, const std::optional<JitterConfig> &config);
+  std::optional<JitterStats> getJitterStats(int id);
+  void setPollerConfig(const PollerConfig &config);
+  DropStats getDropStats(int id);
+  // Grow SO_RCVBUF when the kernel drops datagrams and shrink it again once
+  // quiet, or stop tuning with std::nullopt.
+  void setRecvBufferTuning(int id,
+                           const std::optional<RecvBufferTuning> &tuning);
+  void setPriority(int id, Priority priority);
+  void setDeliveryConfig(const DeliveryConfig &config);
+  // Lane counters since creation or the last reset
+  DeliveryStats getDeliveryStats(bool reset = false);
+  // Consumers that queue events further (e.g. onto a JS thread) report the
+  // normal-priority ones here once processed, which reopens the window.
+  void eventsConsumed(size_t count);
+  // eventsConsumed, for consumers that may outlive the core
+  std::function<void(size_t)> consumer();
+  // Write every datagram sent or received to a pcapng file until
+  // stopCapture; replaces a capture already running.
+  void startCapture(const std::string &path,
+                    const CaptureConfig &config = CaptureConfig());
+  // Flushes and closes the file; std::nullopt if no capture was running.
+  std::optional<CaptureStats> stopCapture();
+
+protected:
+  BatchHandler _handler;
+  DispatchMode _dispatchMode;
+  std::mutex _dispatchMutex;
+  std::atomic<std::thread::id> _dispatchingThread;
+  std::atomic<bool> _invalidate = false;
+  std::thread eventThread;
+
+  void sendEvent(Event event);
+  void enqueueLocked(Event &&event);
+  void pushLocked(Event &&event);
+  void takeBatchLocked(EventBatch &batch);
+  // Hand a batch to the handler outside `mutex`
+  void dispatch(EventBatch &&batch);
+  // Recompute `_queued` from the lanes and arm the aging timer if normal
+  // events are held back.
+  void syncQueuedLocked();
+  void onAgingTimer();
+  void captureSent(int fd, const struct sockaddr_storage &dest,
+                   const void *data, size_t size, int tos);
+  void forgetCaptured(int fd);
+  // Deliver queued events right away in Direct mode, no-op otherwise.
+  void flushEvents();
+  void receiveEvent();
+  int getFdOrThrow(int id);
+
+  // poll-based I/O (replaces worker pool busy-polling)
+  void watchFd(int fd);
+  void unwatchFd(int fd);
+  void pollLoop();
+  // Read up to `budget` datagrams (0: no limit) from a ready socket; true if
+  // the budget ran out before the socket did.
+  bool readSocket(int fd, uint32_t budget, char *buffer,
+                  std::map<int, uint32_t> &dropCounters);
+  void wakePoller();
+  // Re-apply the poller config to the calling I/O thread if it changed.
+  void refreshThreadConfig(unsigned &generation);
+
+  bool isHoldFull();
+  void pumpJitter(int id);
+  void onRequestTimer(uint64_t requestId);
+  void onKernelDrops(int fd, uint32_t count);
+  void checkRecvBuffer(int id);
+  void retransmit(uint64_t requestId);
+  void resumeWarm();
+
+private:
+  std::condition_variable cond;
+  std::mutex mutex;
+  std::unique_ptr<EventLanes> _lanes;
+  // Events the lanes would hand out now, for spinning without the lock
+  std::atomic<size_t> _queued = 0;
+  // Sockets in the high-priority lane, guarded by `mutex`
+  std::set<int> _highPriority;
+  uint64_t _agingTimer = 0;
+  // Lets consumers report back after the core is gone
+  struct ConsumerLink {
+    std::recursive_mutex mutex;
+    UdpCore *core;
+  };
+  std::shared_ptr<ConsumerLink> _consumerLink;
+  std::map<int, int> idToFdMap;
+  std::atomic<int> nextId = 1;
+
+  // poll-based I/O
+  std::thread _pollThread;
+  int _wakePipe[2] = {-1, -1};
+  std::set<int> _watchedFds;
+  // Unwatched since the poll thread last looked; it drops their drop
+  // counters, which would otherwise be read against a reused fd
+  std::vector<int> _unwatchedFds;
+  std::mutex _watchMutex;
+
+  // low-latency poller, config guarded by `_watchMutex`
+  PollerConfig _pollerConfig;
+  std::atomic<unsigned> _pollerGeneration = 0;
+  std::atomic<uint32_t> _spinUs = 0;
+  std::atomic<uint32_t> _readBudget = PollerConfig().readBudget;
+
+  std::vector<SocketState> suspendedSockets;
+
+  // warm suspend
+  SuspendMode _suspendMode = SuspendMode::Cold;
+  // Written under `mutex`, read by the poll thread without it
+  std::atomic<size_t> _holdCapacity = 0;
+  std::atomic<bool> _suspended = false;
+  std::atomic<size_t> _heldBytes = 0;
+  std::deque<Event> _held;
+  std::map<int, SocketState> _warmStates;
+
+  // jitter buffers by socket id, guarded by `mutex`
+  struct JitterStage {
+    std::unique_ptr<JitterBuffer> buffer;
+    std::optional<TimerQueue::Clock::time_point> armed;
+    // The pending playout timer, so at most one is scheduled per stage
+    uint64_t timer = 0;
+  };
+  std::map<int, JitterStage> _jitterStages;
+  void armJitter(int id, JitterStage &stage);
+
+  // outstanding requests, guarded by `mutex`
+  struct Transaction {
+    int socketId;
+    struct sockaddr_storage dest;
+    socklen_t destLen;
+    std::string data;
+    std::tuple<int, size_t, size_t, std::string> key;
+    bool anySource;
+    int retriesLeft;
+    std::chrono::microseconds timeout;
+    double backoff;
+    uint64_t timer;
+  };
+  std::map<uint64_t, Transaction> _requests;
+  // (socket id, token offset, token length, token) -> request id
+  std::map<std::tuple<int, size_t, size_t, std::string>, uint64_t>
+      _requestTokens;
+  uint64_t _nextRequestId = 1;
+  bool matchReply(int id, Event &event);
+  void dropRequests(int id);
+
+  // kernel drops and SO_RCVBUF tuning by socket id, guarded by `mutex`
+  struct ReceiveState {
+    uint64_t drops = 0;
+    std::optional<RecvBufferTuning> tuning;
+    int bufferBytes = 0;
+    int floorBytes = 0;
+    // tuning->maxBytes, lowered once the kernel clamps the size
+    int ceilingBytes = 0;
+    uint64_t dropsAtCheck = 0;
+    std::chrono::steady_clock::time_point lastGrow;
+    uint64_t timer = 0;
+  };
+  std::map<int, ReceiveState> _receiveStates;
+
+  // pcapng capture; `_capturing` keeps the hot path to one atomic load
+  std::atomic<bool> _capturing = false;
+  std::shared_ptr<PacketCapture> _capture;
+
+  TimerQueue _timers;
+};
+} // namespace jsiudp
@@ -1,3 +1,4 @@
+import { startCapture, stopCapture } from 'react-native-jsi-udp';
 import {
   assert,
   closeSockets,
@@ -13,7 +14,7 @@ export const errorsSuite: TestSuite = {
   id: 'errors',
   name: 'Error handling',
   description:
-    'Verifies invalid socket creation, invalid destination addresses, and closed-socket failures.',
+    'Verifies invalid socket creation, invalid destination addresses, closed-socket failures, and unwritable capture paths.',
   tests: [
     {
       id: 'errors-invalid-create-type',
@@ -85,5 +86,20 @@ export const errorsSuite: TestSuite = {
         }
       },
     },
+    {
+      id: 'errors-capture-path',
+      name: 'throws when the capture file cannot be created',
+      run: async () => {
+        const error = expectThrow(() => {
+          startCapture('/nonexistent-jsiudp-dir/capture.pcapng');
+        }, /ENOENT|EACCES|EROFS/);
+        assert(
+          stopCapture() === undefined,
+          'Expected no capture to be running after a failed start'
+        );
+
+        return error.message;
+      },
+    },
   ],
 };
@@ -1,23 +1,27 @@
 import { type Socket } from 'react-native-jsi-udp';
 import {
   assert,
+  assertEqual,
   assertIncludes,
   closeSockets,
   createBoundSocket,
+  getLoopbackAddress,
   getWildcardAddress,
   reservePort,
   toErrorMessage,
+  waitForEvent,
   type TestSuite,
 } from './helper';
 
 const WILDCARD = getWildcardAddress('udp4');
+const LOOPBACK = getLoopbackAddress('udp4');
 const BUFFER_TARGET = 32768;
 
 export const optionsSuite: TestSuite = {
   id: 'options',
   name: 'Socket options',
   description:
-    'Covers buffer-size getters/setters, TTL APIs, broadcast flags, and same-port binds.',
+    'Covers buffer-size getters/setters, drop stats, TTL and TOS APIs, broadcast flags, and same-port binds.',
   tests: [
     {
       id: 'options-buffer-sizes',
@@ -47,6 +51,33 @@ export const optionsSuite: TestSuite = {
         }
       },
     },
+    {
+      id: 'options-drop-stats',
+      name: 'reports kernel drops and auto-tunes the receive buffer',
+      run: async () => {
+        const socket = await createBoundSocket('udp4');
+
+        try {
+          const stats = socket.getDropStats();
+          assertEqual(stats.drops, 0);
+          if (!stats.supported) {
+            return 'kernel drop counter not available on this platform';
+          }
+
+          socket.setRecvBufferAutoTune({ min: BUFFER_TARGET, quietMs: 1000 });
+          const { recvBufferSize } = socket.getDropStats();
+          assert(
+            recvBufferSize >= BUFFER_TARGET,
+            `Expected the auto-tune floor to apply, received ${recvBufferSize}`
+          );
+          socket.setRecvBufferAutoTune(null);
+
+          return `recv=${recvBufferSize}, drops=${stats.drops}`;
+        } finally {
+          closeSockets(socket);
+        }
+      },
+    },
     {
       id: 'options-ttl-and-broadcast',
       name: 'accepts broadcast, TTL, and multicast loopback settings',
@@ -119,5 +150,93 @@ export const optionsSuite: TestSuite = {
         }
       },
     },
+    {
+      id: 'options-packet-info',
+      name: 'reports destination and interface on a wildcard socket',
+      run: async () => {
+        const receiver = await createBoundSocket('udp4', 0, WILDCARD, {
+          recvPacketInfo: true,
+        });
+        const sender = await createBoundSocket('udp4', 0, WILDCARD);
+
+        try {
+          const pendingEvent = waitForEvent(receiver, 'message');
+          await new Promise<void>((resolve, reject) => {
+            sender.sendFrom(
+              { address: LOOPBACK },
+              'pktinfo',
+              0,
+              undefined,
+              receiver.address().port,
+              LOOPBACK,
+              (error?: Error) => (error ? reject(error) : resolve())
+            );
+          });
+          const [, rinfo] = await pendingEvent;
+          const localAddress = Reflect.get(rinfo as object, 'localAddress');
+          const interfaceIndex = Reflect.get(rinfo as object, 'interfaceIndex');
+
+          assertEqual(localAddress, LOOPBACK);
+          assert(
+            typeof interfaceIndex === 'number' && interfaceIndex > 0,
+            `Expected an interface index, received ${String(interfaceIndex)}`
+          );
+
+          return `arrived on ${localAddress} (if ${interfaceIndex})`;
+        } finally {
+          closeSockets(sender, receiver);
+        }
+      },
+    },
+    {
+      id: 'options-tos-ecn',
+      name: 'marks DSCP per socket and per send and reports ECN',
+      run: async () => {
+        const receiver = await createBoundSocket('udp4', 0, LOOPBACK, {
+          recvTOS: true,
+        });
+        const sender = await createBoundSocket('udp4', 0, LOOPBACK);
+        // EF (46) with ECT(0), then AF41 (34) with ECT(1)
+        const socketTos = (46 << 2) | 2;
+        const sendTos = (34 << 2) | 1;
+
+        try {
+          sender.setTOS(socketTos);
+          assertEqual(sender.getTOS(), socketTos);
+
+          const first = waitForEvent(receiver, 'message');
+          sender.send(
+            'tos-socket',
+            0,
+            undefined,
+            receiver.address().port,
+            LOOPBACK
+          );
+          const [, socketInfo] = await first;
+          assertEqual(Reflect.get(socketInfo as object, 'dscp'), 46);
+          assertEqual(Reflect.get(socketInfo as object, 'ecn'), 2);
+
+          const second = waitForEvent(receiver, 'message');
+          await new Promise<void>((resolve, reject) => {
+            sender.sendFrom(
+              { tos: sendTos },
+              'tos-send',
+              0,
+              undefined,
+              receiver.address().port,
+              LOOPBACK,
+              (error?: Error) => (error ? reject(error) : resolve())
+            );
+          });
+          const [, sendInfo] = await second;
+          assertEqual(Reflect.get(sendInfo as object, 'tos'), sendTos);
+          assertEqual(Reflect.get(sendInfo as object, 'ecn'), 1);
+
+          return `socket tos=${socketTos}, per-send tos=${sendTos}`;
+        } finally {
+          closeSockets(sender, receiver);
+        }
+      },
+    },
   ],
 };
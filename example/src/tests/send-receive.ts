@@ -1,13 +1,17 @@
 import { Buffer } from 'buffer';
+import { getDeliveryStats } from 'react-native-jsi-udp';
 import {
   assert,
   assertEqual,
   closeSockets,
   createBoundSocket,
   createPayload,
+  createSocket,
   getLoopbackAddress,
   sendAsync,
+  skipOnPlatform,
   toRemoteInfo,
+  waitForEvent,
   waitForMessage,
   waitForMessages,
   type TestSuite,
@@ -21,7 +25,7 @@ export const sendReceiveSuite: TestSuite = {
   id: 'send-receive',
   name: 'Send / receive',
   description:
-    'Verifies loopback delivery, multi-kilobyte payload handling, zero-length packets, and rapid bursts.',
+    'Verifies loopback delivery, multi-kilobyte payload handling, zero-length packets, rapid bursts, and priority lanes.',
   tests: [
     {
       id: 'send-receive-string-loopback',
@@ -45,6 +49,176 @@ export const sendReceiveSuite: TestSuite = {
         }
       },
     },
+    {
+      id: 'send-receive-remote-info',
+      name: 'reports sender address, port, family and size in rinfo',
+      run: async () => {
+        const sender = await createBoundSocket('udp4', 0, LOOPBACK);
+        const receiver = await createBoundSocket('udp4', 0, LOOPBACK);
+
+        try {
+          const addresses: string[] = [];
+          for (const payload of ['rinfo-1', 'rinfo-22']) {
+            const pendingEvent = waitForEvent(receiver, 'message');
+            await sendAsync(
+              sender,
+              payload,
+              receiver.address().port,
+              LOOPBACK
+            );
+            const [message, rinfo] = await pendingEvent;
+            const info = toRemoteInfo(rinfo);
+
+            assert(Buffer.isBuffer(message), 'Expected a Buffer message');
+            assertEqual(info.port, sender.address().port);
+            assertEqual(info.family, 'IPv4');
+            assertEqual(
+              Reflect.get(rinfo as object, 'size'),
+              message.length,
+              'Expected rinfo.size to match the payload length'
+            );
+            assert(
+              Object.keys({ ...(rinfo as object) }).includes('address'),
+              'Expected rinfo to be spreadable'
+            );
+            addresses.push(info.address);
+          }
+
+          assertEqual(addresses[0], LOOPBACK);
+          assertEqual(addresses[1], addresses[0]);
+          return `from ${addresses[0]}`;
+        } finally {
+          closeSockets(sender, receiver);
+        }
+      },
+    },
+    {
+      id: 'send-receive-jitter-buffer',
+      name: 'reorders and dedupes packets in the native jitter buffer',
+      run: async () => {
+        const sender = await createBoundSocket('udp4', 0, LOOPBACK);
+        const receiver = await createBoundSocket('udp4', 0, LOOPBACK);
+
+        try {
+          receiver.setJitterBuffer({ seqOffset: 0, playoutDelayMs: 50 });
+          const pendingMessages = waitForMessages(receiver, 4);
+          for (const seq of [10, 12, 11, 12, 13]) {
+            const packet = createPayload(4);
+            packet.writeUInt16BE(seq, 0);
+            await sendAsync(sender, packet, receiver.address().port, LOOPBACK);
+          }
+
+          const messages = await pendingMessages;
+          const order = messages.map(({ message }) => message.readUInt16BE(0));
+          assertEqual(order.join(','), '10,11,12,13');
+
+          const stats = receiver.getJitterStats();
+          assert(stats, 'Expected jitter stats');
+          assertEqual(stats.reordered, 1);
+          assertEqual(stats.duplicates, 1);
+          assertEqual(stats.lost, 0);
+          return `released ${stats.released} of ${stats.received}`;
+        } finally {
+          closeSockets(sender, receiver);
+        }
+      },
+    },
+    {
+      id: 'send-receive-request-reply',
+      name: 'matches replies by token and retransmits natively',
+      run: async () => {
+        const client = await createBoundSocket('udp4', 0, LOOPBACK);
+        const server = await createBoundSocket('udp4', 0, LOOPBACK);
+        const options = { tokenOffset: 0, tokenLength: 2, timeoutMs: 50 };
+        let attempts = 0;
+
+        // Ignore the first attempt so the reply answers a retransmission
+        server.on('message', (message: Buffer, info: unknown) => {
+          attempts += 1;
+          if (attempts === 1) return;
+          const { port, address } = toRemoteInfo(info);
+          server.send(message, 0, message.length, port, address);
+        });
+
+        const request = (data: Buffer, retries: number) =>
+          new Promise<Buffer>((resolve, reject) => {
+            client.sendRequest(
+              data,
+              server.address().port,
+              LOOPBACK,
+              { ...options, retries },
+              (error, reply) => (error ? reject(error) : resolve(reply!))
+            );
+          });
+
+        try {
+          const reply = await request(Buffer.from('t1-request'), 2);
+          assertEqual(reply.toString(), 't1-request');
+          assertEqual(attempts, 2);
+
+          server.removeAllListeners('message');
+          const error = await request(Buffer.from('t2-request'), 1).then(
+            () => undefined,
+            (e: Error) => e
+          );
+          assertEqual(error?.message, 'ETIMEDOUT');
+
+          // An empty token would match every datagram
+          const invalid = await new Promise<Error | null>((resolve) => {
+            client.sendRequest(
+              Buffer.from('t3-request'),
+              server.address().port,
+              LOOPBACK,
+              { ...options, tokenLength: 0 },
+              resolve
+            );
+          });
+          assertEqual(invalid?.message, 'EINVAL');
+          return `replied after ${attempts} attempts`;
+        } finally {
+          closeSockets(client, server);
+        }
+      },
+    },
+    {
+      id: 'send-receive-unix-dgram',
+      name: 'exchanges datagrams over AF_UNIX sockets',
+      skip: skipOnPlatform(['ios'], 'Abstract socket names are Linux-only'),
+      run: async () => {
+        const server = createSocket('unix_dgram');
+        const client = createSocket('unix_dgram');
+        const path = `@jsiudp-test-${Date.now()}`;
+
+        try {
+          await new Promise<void>((resolve, reject) => {
+            server.bind(path, (error?: Error) =>
+              error ? reject(error) : resolve()
+            );
+          });
+          // Unbound sockets get an autogenerated name so they can be replied to
+          await new Promise<void>((resolve, reject) => {
+            client.bind(undefined, (error?: Error) =>
+              error ? reject(error) : resolve()
+            );
+          });
+          assertEqual(server.address().address, path);
+          assertEqual(server.address().family, 'unix');
+
+          server.on('message', (message: Buffer, info: unknown) => {
+            server.send(message, 0, message.length, toRemoteInfo(info).address);
+          });
+          const pendingReply = waitForEvent(client, 'message');
+          client.send('unix-echo', 0, undefined, path);
+          const [message, rinfo] = await pendingReply;
+
+          assertEqual(message.toString(), 'unix-echo');
+          assertEqual(toRemoteInfo(rinfo).address, path);
+          return `echoed via ${path}`;
+        } finally {
+          closeSockets(client, server);
+        }
+      },
+    },
     {
       id: 'send-receive-buffer-echo',
       name: 'round-trips a Buffer between two sockets',
@@ -177,5 +351,48 @@ export const sendReceiveSuite: TestSuite = {
         }
       },
     },
+    {
+      id: 'send-receive-priority-lanes',
+      name: 'delivers a high-priority socket alongside a normal burst',
+      run: async () => {
+        const sender = await createBoundSocket('udp4', 0, LOOPBACK);
+        const bulk = await createBoundSocket('udp4', 0, LOOPBACK);
+        const control = await createBoundSocket('udp4', 0, LOOPBACK, {
+          priority: 'high',
+        });
+
+        try {
+          getDeliveryStats(true);
+          const pendingBulk = waitForMessages(bulk, RAPID_MESSAGE_COUNT, 7000);
+          const pendingControl = waitForMessage(control);
+          await Promise.all(
+            Array.from({ length: RAPID_MESSAGE_COUNT }, (_, index) =>
+              sendAsync(sender, `bulk-${index}`, bulk.address().port, LOOPBACK)
+            )
+          );
+          await sendAsync(sender, 'control', control.address().port, LOOPBACK);
+          const [received, { message }] = await Promise.all([
+            pendingBulk,
+            pendingControl,
+          ]);
+          const stats = getDeliveryStats();
+
+          assertEqual(received.length, RAPID_MESSAGE_COUNT);
+          assertEqual(message.toString(), 'control');
+          assert(
+            stats.high.delivered >= 1,
+            `Expected a high-lane delivery, received ${stats.high.delivered}`
+          );
+          assert(
+            stats.normal.delivered >= RAPID_MESSAGE_COUNT,
+            `Expected ${RAPID_MESSAGE_COUNT} normal-lane deliveries, received ${stats.normal.delivered}`
+          );
+
+          return `high wait ${stats.high.maxWaitUs}us, normal wait ${stats.normal.maxWaitUs}us (max depth ${stats.normal.maxDepth})`;
+        } finally {
+          closeSockets(sender, bulk, control);
+        }
+      },
+    },
   ],
 };
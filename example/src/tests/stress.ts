@@ -1,4 +1,5 @@
 import { Buffer } from 'buffer';
+import { setRemoteInfoMode, type RemoteInfo } from 'react-native-jsi-udp';
 import {
   assert,
   delay,
@@ -20,11 +21,57 @@ const SOCKET_COUNT = 100;
 const BURST_COUNT = 1000;
 const LATENCY_ITERATIONS = 100;
 
+// Wall time per packet to receive a burst, optionally reading every rinfo
+// field, which is what the lazy and eager rinfo modes trade off.
+async function timeBurst(readFields: boolean): Promise<number> {
+  const sender = await createBoundSocket('udp4', 0, LOOPBACK);
+  const receiver = await createBoundSocket('udp4', 0, LOOPBACK);
+  const payload = Buffer.from('rinfo');
+  let sink = 0;
+
+  try {
+    const startedAt = performance.now();
+    const done = new Promise<void>((resolve, reject) => {
+      let received = 0;
+      const timer = setTimeout(
+        () => reject(new Error(`Received ${received}/${BURST_COUNT} packets`)),
+        10000
+      );
+      receiver.on('message', (_message: Buffer, rinfo: RemoteInfo) => {
+        if (readFields) {
+          sink += rinfo.address.length + rinfo.port + rinfo.size;
+          sink += rinfo.family.length;
+        }
+        received += 1;
+        if (received === BURST_COUNT) {
+          clearTimeout(timer);
+          resolve();
+        }
+      });
+    });
+    const BATCH_SIZE = 100;
+    const port = receiver.address().port;
+    for (let i = 0; i < BURST_COUNT; i += BATCH_SIZE) {
+      await Promise.all(
+        Array.from({ length: BATCH_SIZE }, () =>
+          sendAsync(sender, payload, port, LOOPBACK)
+        )
+      );
+      await delay(0);
+    }
+    await done;
+    assert(!readFields || sink > 0, 'Expected rinfo fields to be read');
+    return ((performance.now() - startedAt) * 1000) / BURST_COUNT;
+  } finally {
+    closeSockets(sender, receiver);
+  }
+}
+
 export const stressSuite: TestSuite = {
   id: 'stress',
   name: 'Stress / performance',
   description:
-    'Creates many sockets, moves 1000 packets in one burst, and records 100 echo round-trip timings.',
+    'Creates many sockets, moves 1000 packets in one burst, times lazy and eager rinfo, and records 100 echo round-trip timings.',
   tests: [
     {
       id: 'stress-create-and-close-100',
@@ -88,6 +135,26 @@ export const stressSuite: TestSuite = {
         }
       },
     },
+    {
+      id: 'stress-rinfo-modes',
+      name: 'times lazy and eager rinfo over 1000 packet bursts',
+      run: async () => {
+        const results: string[] = [];
+        try {
+          for (const mode of ['lazy', 'eager'] as const) {
+            setRemoteInfoMode(mode);
+            for (const readFields of [false, true]) {
+              const perPacket = await timeBurst(readFields);
+              const label = readFields ? `${mode}+reads` : mode;
+              results.push(`${label}=${perPacket.toFixed(1)}us/pkt`);
+            }
+          }
+        } finally {
+          setRemoteInfoMode('lazy');
+        }
+        return results.join(', ');
+      },
+    },
     {
       id: 'stress-latency-round-trip',
       name: 'records 100 echo round-trip timings',
@@ -17,5 +17,15 @@ export const suspendResumeSuite: TestSuite = {
       manualInstructions:
         'Run the Send / Receive suite first, background the app for a few seconds, return to the foreground, and rerun the loopback tests to confirm sockets still receive packets.',
     },
+    {
+      id: 'suspend-resume-ios-warm-manual',
+      name: 'manual iOS warm suspend keeps ports and held packets',
+      skip: () =>
+        Platform.OS === 'ios'
+          ? undefined
+          : 'Manual suspend/resume validation only applies to iOS.',
+      manualInstructions:
+        "Call setSuspendMode('warm') and bind a socket to port 0, note its port, and keep a peer sending to it. Background the app for a few seconds, return to the foreground, and confirm the port is unchanged and packets sent while backgrounded are delivered on resume.",
+    },
   ],
 };
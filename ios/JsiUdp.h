@@ -5,4 +5,14 @@
 
 @interface JsiUdp : NSObject <RCTBridgeModule>
 
+#ifdef __cplusplus
+// Expose the datagram_* API on a secondary runtime (e.g. a worklet runtime),
+// on that runtime's thread, once the main runtime has installed the module.
+// Uninstall before the runtime is torn down; that closes its sockets.
++ (BOOL)installRuntime:(facebook::jsi::Runtime *)runtime
+           callInvoker:
+               (std::shared_ptr<facebook::react::CallInvoker>)callInvoker;
++ (BOOL)uninstallRuntime:(facebook::jsi::Runtime *)runtime;
+#endif
+
 @end
@@ -31,8 +31,17 @@ std::shared_ptr<jsiudp::UdpManager> _manager;
 // Renamed to avoid duplicate symbol with react-native-worklets-core
 static void installJsiUdpApi(std::shared_ptr<facebook::react::CallInvoker> callInvoker,
                              facebook::jsi::Runtime *runtime) {
-  _manager =
-      std::make_shared<jsiudp::UdpManager>(runtime, std::move(callInvoker));
+  _manager = jsiudp::UdpManager::make(runtime, std::move(callInvoker));
+}
+
++ (BOOL)installRuntime:(facebook::jsi::Runtime *)runtime
+           callInvoker:
+               (std::shared_ptr<facebook::react::CallInvoker>)callInvoker {
+  return jsiudp::UdpManager::installRuntime(runtime, std::move(callInvoker));
+}
+
++ (BOOL)uninstallRuntime:(facebook::jsi::Runtime *)runtime {
+  return jsiudp::UdpManager::uninstallRuntime(runtime);
 }
 
 RCT_EXPORT_BLOCKING_SYNCHRONOUS_METHOD(install) {
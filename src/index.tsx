@@ -19,10 +19,160 @@ const JsiUdp = NativeModules.JsiUdp
       }
     );
 
+function ensureInstalled() {
+  if (typeof globalThis.datagram_create !== 'function') {
+    JsiUdp.install();
+  }
+}
+
+// unix_dgram is an AF_UNIX datagram socket for IPC on the device, addressed
+// by a filesystem path or "@name" (Linux abstract namespace) instead of an
+// address and port.
+export type SocketType = 'udp4' | 'udp6' | 'unix_dgram';
+
+// Events of 'high' sockets reach JS ahead of queued 'normal' ones.
+export type Priority = 'normal' | 'high';
+
 export interface Options {
-  type: 'udp4' | 'udp6';
+  type: SocketType;
   reuseAddr?: boolean;
   reusePort?: boolean;
+  // Report the local address and interface each datagram arrived on
+  recvPacketInfo?: boolean;
+  // Report the TOS / traffic class byte (DSCP and ECN) of each datagram
+  recvTOS?: boolean;
+  // Delivery lane for this socket's events (default 'normal')
+  priority?: Priority;
+}
+
+export interface RemoteInfo {
+  // The sender's path for unix_dgram sockets, '' if it is unbound
+  address: string;
+  family: 'IPv4' | 'IPv6' | 'unix';
+  port: number;
+  size: number;
+  // Only present when recvPacketInfo is enabled
+  localAddress?: string;
+  interfaceIndex?: number;
+  // Only present when recvTOS is enabled; tos is (dscp << 2) | ecn
+  tos?: number;
+  dscp?: number;
+  ecn?: number;
+}
+
+// Locates the token that pairs a request with its reply; the same bytes
+// must appear at the same offset in the reply.
+export interface RequestOptions {
+  tokenOffset: number;
+  // Must be at least 1
+  tokenLength: number;
+  // Accept replies from any address, not only the one the request went to
+  anySource?: boolean;
+  // Retransmissions after the first send (default 4)
+  retries?: number;
+  // Time to wait before the first retransmission (default 2000)
+  timeoutMs?: number;
+  // Factor applied to the wait after each retransmission (default 2)
+  backoff?: number;
+}
+
+export type RequestCallback = (
+  error: Error | null,
+  reply?: Buffer,
+  rinfo?: RemoteInfo
+) => void;
+
+export interface SourceInfo {
+  address?: string;
+  interfaceIndex?: number;
+  // TOS / traffic class byte for this datagram, (dscp << 2) | ecn
+  tos?: number;
+}
+
+// Native reorder/playout stage; fields are read big-endian from the payload.
+// Defaults match an RTP header (sequence number at 2, timestamp at 4).
+export interface JitterBufferOptions {
+  seqOffset?: number;
+  seqBytes?: number;
+  timestampOffset?: number;
+  timestampBytes?: number;
+  // Timestamp units per second; without it packets are scheduled by
+  // packetIntervalMs, or released playoutDelayMs after arrival
+  clockRate?: number;
+  packetIntervalMs?: number;
+  playoutDelayMs?: number;
+  window?: number;
+}
+
+export interface JitterStats {
+  received: number;
+  released: number;
+  lost: number;
+  reordered: number;
+  late: number;
+  duplicates: number;
+}
+
+// Datagrams the kernel dropped because the receive buffer was full.
+// Only counted on Linux/Android (supported is false elsewhere).
+export interface DropStats {
+  drops: number;
+  supported: boolean;
+  // SO_RCVBUF as reported by the kernel (Linux reports twice the set size)
+  recvBufferSize: number;
+}
+
+// Grow the receive buffer when the kernel drops datagrams, up to max, and
+// halve it again after quietMs without drops, down to min.
+export interface RecvBufferAutoTuneOptions {
+  // Defaults to the buffer size when auto-tuning is enabled
+  min?: number;
+  // Defaults to 4 MiB
+  max?: number;
+  // Defaults to 10000
+  quietMs?: number;
+}
+
+// While any socket has 'high' priority, at most normalWindow 'normal' events
+// wait in the JS queue at once, so a high-priority event is never stuck
+// behind a long backlog.
+export interface DeliveryOptions {
+  // Defaults to 64; 0 turns the limit off
+  normalWindow?: number;
+  // Reopen a full window after this long without progress (default 100)
+  windowTimeoutMs?: number;
+}
+
+export interface LaneStats {
+  // Events queued natively now, and the most seen at once
+  depth: number;
+  maxDepth: number;
+  delivered: number;
+  // Time spent queued natively before being posted to JS
+  avgWaitUs: number;
+  maxWaitUs: number;
+}
+
+export interface DeliveryStats {
+  high: LaneStats;
+  normal: LaneStats;
+  // Normal events posted to JS and not yet run
+  inFlight: number;
+}
+
+export interface CaptureOptions {
+  // Bytes of each datagram's payload to keep; 0 keeps all of it (default 0)
+  snapLen?: number;
+  // Datagrams waiting for the writer beyond this are dropped (default 4 MiB);
+  // each also counts a few hundred bytes of bookkeeping
+  bufferBytes?: number;
+}
+
+export interface CaptureStats {
+  packets: number;
+  bytes: number;
+  // Datagrams not written because the buffer was full or a write failed
+  dropped: number;
 }
 
 export enum State {
@@ -35,28 +185,46 @@ export type Callback = (...args: any[]) => void;
 
 export class Socket extends EventEmitter {
   private state: State;
-  private type: 4 | 6;
+  private type: number;
   private _id: number;
   private reuseAddr: boolean;
   private reusePort: boolean;
+  private recvPacketInfo: boolean;
+  private recvTOS: boolean;
+  private requests = new Map<number, RequestCallback>();
 
-  constructor(options: Options, callback?: Callback) {
+  // adoptId wraps an existing native socket instead; see Socket.adopt
+  constructor(options: Options, callback?: Callback, adoptId?: number) {
     super();
-    if (typeof globalThis.datagram_create !== 'function') {
-      JsiUdp.install();
-    }
+    ensureInstalled();
     this.state = State.UNBOUND;
-    this.type = options.type === 'udp4' ? 4 : 6;
+    this.type =
+      options.type === 'udp4'
+        ? 4
+        : options.type === 'udp6'
+        ? 6
+        : dgc_UNIX_DGRAM;
     this.reuseAddr = options.reuseAddr ?? false;
     this.reusePort = options.reusePort ?? false;
-    this._id = datagram_create(this.type);
+    this.recvPacketInfo = options.recvPacketInfo ?? false;
+    this.recvTOS = options.recvTOS ?? false;
+    if (adoptId === undefined) {
+      this._id = datagram_create(this.type);
+    } else {
+      datagram_adopt(adoptId);
+      this._id = adoptId;
+      const name = datagram_getSockName(adoptId, this.type);
+      if (name.port !== 0 || (this.type === dgc_UNIX_DGRAM && name.address)) {
+        this.state = State.BOUND;
+      }
+    }
+    if (options.priority) this.setPriority(options.priority);
     datagram_callbacks[String(this._id)] = ({
       type,
-      family,
-      address: remoteAddr,
-      port: remotePort,
       data,
+      rinfo,
       error,
+      requestId,
     }) => {
       switch (type) {
         case 'error':
@@ -68,18 +236,44 @@ export class Socket extends EventEmitter {
           delete datagram_callbacks[String(this._id)];
           break;
         case 'message':
-          this.emit('message', Buffer.from(data!), {
-            address: remoteAddr,
-            port: remotePort,
-            family,
-          });
+          // rinfo is a native host object; address is formatted on access
+          this.emit('message', Buffer.from(data!), rinfo);
+          break;
+        case 'reply':
+        case 'timeout':
+          this.settleRequest(requestId!, type, data, rinfo);
           break;
       }
     };
     if (callback) this.on('message', callback);
   }
 
-  bind(port?: number, address?: string | Callback, callback?: Callback) {
+  // Takes over a socket created on another runtime sharing this module (see
+  // "Secondary runtimes" in the README): from now on its events are delivered
+  // to this runtime. Stop using the Socket on the original runtime.
+  static adopt(
+    id: number,
+    options: Options | SocketType,
+    callback?: Callback
+  ): Socket {
+    if (typeof options === 'string') {
+      options = { type: options };
+    }
+    return new Socket(options, callback, id);
+  }
+
+  // Native handle of the socket, for Socket.adopt on another runtime
+  get id(): number {
+    return this._id;
+  }
+
+  // unix_dgram sockets bind to a path: bind(path, callback). Without one,
+  // Linux picks an abstract name.
+  bind(
+    port?: number | string,
+    address?: string | Callback,
+    callback?: Callback
+  ) {
     if (this.state !== State.UNBOUND) {
       throw new Error('Socket is already bound');
     }
@@ -87,7 +281,22 @@ export class Socket extends EventEmitter {
       callback = address;
       address = undefined;
     }
+    if (typeof port === 'string') {
+      address = port;
+      port = 0;
+    }
     if (callback) this.once('listening', callback!);
+    if (this.type === dgc_UNIX_DGRAM) {
+      try {
+        datagram_bind(this._id, this.type, address ?? '', 0);
+        this.state = State.BOUND;
+        this.emit('listening');
+      } catch (e) {
+        if (callback) callback(e);
+        else this.emit('error', e);
+      }
+      return;
+    }
     const defaultAddr = this.type === 4 ? '0.0.0.0' : '::1';
     try {
       datagram_setOpt(
@@ -102,6 +311,9 @@ export class Socket extends EventEmitter {
         dgc_SO_REUSEPORT,
         this.reusePort ? 1 : 0
       );
+      // Must precede bind so a wildcard socket is not pinned to one interface
+      if (this.recvPacketInfo) this.setRecvPacketInfo(true);
+      if (this.recvTOS) this.setRecvTOS(true);
       datagram_bind(this._id, this.type, address ?? defaultAddr, port ?? 0);
       this.state = State.BOUND;
       this.emit('listening');
@@ -111,12 +323,54 @@ export class Socket extends EventEmitter {
     }
   }
 
+  // unix_dgram sockets take a path instead: send(data, offset, length,
+  // path, callback). A full receiver queue fails with EAGAIN rather than
+  // dropping the datagram.
   send(
+    data: string | Buffer,
+    offset: number | undefined,
+    length: number | undefined,
+    port: number | string,
+    address?: string | Callback,
+    callback?: Callback
+  ) {
+    if (typeof port === 'string') {
+      callback = address as Callback | undefined;
+      address = port;
+      port = 0;
+    }
+    this._send(
+      data,
+      offset,
+      length,
+      port,
+      address as string,
+      undefined,
+      callback
+    );
+  }
+
+  // Like send(), but picks the source address and/or outgoing interface
+  // (IP_PKTINFO / IPV6_PKTINFO) or the DSCP / ECN marking for this datagram.
+  sendFrom(
+    source: SourceInfo,
+    data: string | Buffer,
+    offset: number | undefined,
+    length: number | undefined,
+    port: number,
+    address: string,
+    callback?: Callback
+  ) {
+    this._send(data, offset, length, port, address, source, callback);
+  }
+
+  private _send(
     data: string | Buffer,
     offset: number | undefined,
     length: number | undefined,
     port: number,
     address: string,
+    source: SourceInfo | undefined,
     callback?: Callback
   ) {
     let buf: Buffer;
@@ -127,7 +381,7 @@ export class Socket extends EventEmitter {
     }
     buf = buf.slice(offset ?? 0, length ?? buf.length);
     try {
-      datagram_send(this._id, this.type, address, port, buf.buffer);
+      datagram_send(this._id, this.type, address, port, buf.buffer, source);
       callback?.();
     } catch (e) {
       if (callback) callback(e);
@@ -135,6 +389,45 @@ export class Socket extends EventEmitter {
     }
   }
 
+  // Send a request that is retransmitted natively until a datagram carrying
+  // the same token arrives. The callback runs once, with the reply or with
+  // an ETIMEDOUT error.
+  sendRequest(
+    data: string | Buffer,
+    port: number,
+    address: string,
+    options: RequestOptions,
+    callback: RequestCallback
+  ) {
+    const buf = typeof data === 'string' ? Buffer.from(data) : data;
+    try {
+      const requestId = datagram_sendRequest(
+        this._id,
+        this.type,
+        address,
+        port,
+        buf.buffer.slice(buf.byteOffset, buf.byteOffset + buf.length),
+        options
+      );
+      this.requests.set(requestId, callback);
+    } catch (e) {
+      callback(e as Error);
+    }
+  }
+
+  private settleRequest(
+    requestId: number,
+    type: 'reply' | 'timeout',
+    data?: ArrayBuffer,
+    rinfo?: RemoteInfo
+  ) {
+    const callback = this.requests.get(requestId);
+    if (!callback) return;
+    this.requests.delete(requestId);
+    if (type === 'reply') callback(null, Buffer.from(data!), rinfo);
+    else callback(new Error('ETIMEDOUT'));
+  }
+
   close(callback?: Callback) {
     if (this.state === State.CLOSED) {
       return;
@@ -147,6 +440,10 @@ export class Socket extends EventEmitter {
       // Socket may already be closed by native closeAll/suspendAll
     }
     delete datagram_callbacks[String(this._id)];
+    // Native transactions die with the socket
+    const pending = [...this.requests.values()];
+    this.requests.clear();
+    pending.forEach((request) => request(new Error('ECANCELED')));
     this.emit('close');
   }
 
@@ -162,10 +459,42 @@ export class Socket extends EventEmitter {
     return datagram_getOpt(this._id, dgc_SOL_SOCKET, dgc_SO_RCVBUF);
   }
 
+  setRecvPacketInfo(flag: boolean) {
+    datagram_setOpt(
+      this._id,
+      this.type === 4 ? dgc_IPPROTO_IP : dgc_IPPROTO_IPV6,
+      this.type === 4 ? dgc_IP_RECVPKTINFO : dgc_IPV6_RECVPKTINFO,
+      flag ? 1 : 0
+    );
+  }
+
+  // Pass incoming messages through the native jitter buffer, or remove it
+  // with null (anything it holds is delivered right away).
+  setJitterBuffer(options: JitterBufferOptions | null) {
+    datagram_setJitterBuffer(this._id, options);
+  }
+
+  getJitterStats(): JitterStats | undefined {
+    return datagram_getJitterStats(this._id);
+  }
+
   setRecvBufferSize(size: number) {
     datagram_setOpt(this._id, dgc_SOL_SOCKET, dgc_SO_RCVBUF, size);
   }
 
+  getDropStats(): DropStats {
+    return datagram_getDropStats(this._id);
+  }
+
+  setRecvBufferAutoTune(options: RecvBufferAutoTuneOptions | null) {
+    datagram_setRecvBufferAutoTune(this._id, options);
+  }
+
+  // Events already queued natively keep their lane
+  setPriority(priority: Priority) {
+    datagram_setPriority(this._id, priority);
+  }
+
   getSendBufferSize() {
     return datagram_getOpt(this._id, dgc_SOL_SOCKET, dgc_SO_SNDBUF);
   }
@@ -212,6 +541,33 @@ export class Socket extends EventEmitter {
     );
   }
 
+  // DSCP / ECN marking for everything this socket sends, (dscp << 2) | ecn
+  setTOS(tos: number) {
+    datagram_setOpt(
+      this._id,
+      this.type === 4 ? dgc_IPPROTO_IP : dgc_IPPROTO_IPV6,
+      this.type === 4 ? dgc_IP_TOS : dgc_IPV6_TCLASS,
+      tos
+    );
+  }
+
+  getTOS() {
+    return datagram_getOpt(
+      this._id,
+      this.type === 4 ? dgc_IPPROTO_IP : dgc_IPPROTO_IPV6,
+      this.type === 4 ? dgc_IP_TOS : dgc_IPV6_TCLASS
+    );
+  }
+
+  setRecvTOS(flag: boolean) {
+    datagram_setOpt(
+      this._id,
+      this.type === 4 ? dgc_IPPROTO_IP : dgc_IPPROTO_IPV6,
+      this.type === 4 ? dgc_IP_RECVTOS : dgc_IPV6_RECVTCLASS,
+      flag ? 1 : 0
+    );
+  }
+
   setTTL(ttl: number) {
     datagram_setOpt(
       this._id,
@@ -230,7 +586,82 @@ export class Socket extends EventEmitter {
   }
 }
 
-export function createSocket(options: Options | 'udp4' | 'udp6') {
+export type SuspendMode = 'cold' | 'warm';
+
+const DEFAULT_HOLD_BYTES = 256 * 1024;
+
+// Controls what happens to sockets when the app is backgrounded (iOS).
+// 'cold' closes them and rebinds on resume; 'warm' keeps them bound and holds
+// up to holdBytes of incoming traffic natively until resume. Throws EBUSY
+// while the app is suspended.
+export function setSuspendMode(
+  mode: SuspendMode,
+  holdBytes: number = DEFAULT_HOLD_BYTES
+) {
+  ensureInstalled();
+  datagram_setSuspendMode(mode, holdBytes);
+}
+
+export interface PollerOptions {
+  // Keep the I/O threads busy-waiting this long after the last packet before
+  // they sleep; trades CPU for wakeup latency (default 0)
+  spinUs?: number;
+  // SO_BUSY_POLL budget for every socket, Linux/Android only (default 0)
+  busyPollUs?: number;
+  // Nice value for the I/O threads; mapped to a QoS class on iOS
+  priority?: number;
+  // CPUs the I/O threads may run on, Linux/Android only
+  cpus?: number[];
+  // Datagrams read from one socket before the next ready socket gets a turn,
+  // so a flooded socket cannot starve the others; 0 drains each socket
+  // (default 32)
+  readBudget?: number;
+}
+
+// Tunes the native I/O threads shared by all sockets; call with no options to
+// return to plain blocking polls.
+export function setPollerOptions(options: PollerOptions = {}) {
+  ensureInstalled();
+  datagram_setPollerOptions(options);
+}
+
+// Tunes how far normal-priority events may run ahead of high-priority ones;
+// process-wide like the poller options.
+export function setDeliveryOptions(options: DeliveryOptions = {}) {
+  ensureInstalled();
+  datagram_setDeliveryOptions(options);
+}
+
+// Per-lane counters since start or the last reset
+export function getDeliveryStats(reset: boolean = false): DeliveryStats {
+  ensureInstalled();
+  return datagram_getDeliveryStats(reset);
+}
+
+// Records every datagram sent or received by UDP sockets to a pcapng file
+// until stopCapture; replaces a capture already running.
+export function startCapture(path: string, options: CaptureOptions = {}) {
+  ensureInstalled();
+  datagram_startCapture(path, options);
+}
+
+// Flushes and closes the capture file; undefined if none was running
+export function stopCapture(): CaptureStats | undefined {
+  ensureInstalled();
+  return datagram_stopCapture();
+}
+
+export type RemoteInfoMode = 'lazy' | 'eager';
+
+// How rinfo is built for this JS runtime. 'lazy' (the default) hands out a
+// native host object that formats fields on read; 'eager' builds a plain
+// object up front, which is cheaper when every field of every message is read.
+export function setRemoteInfoMode(mode: RemoteInfoMode) {
+  ensureInstalled();
+  datagram_setRemoteInfoMode(mode);
+}
+
+export function createSocket(options: Options | SocketType) {
   if (typeof options === 'string') {
     options = { type: options };
   }
@@ -239,5 +670,12 @@ export function createSocket(options: Options | 'udp4' | 'udp6') {
 
 export default {
   createSocket,
+  setSuspendMode,
+  setPollerOptions,
+  setDeliveryOptions,
+  getDeliveryStats,
+  startCapture,
+  stopCapture,
+  setRemoteInfoMode,
   Socket,
 };
@@ -1,17 +1,26 @@
-declare function datagram_create(type: 4 | 6): number;
+declare function datagram_create(type: number): number;
+
+declare interface datagram_rinfo {
+  address: string;
+  family: 'IPv4' | 'IPv6' | 'unix';
+  port: number;
+  size: number;
+  localAddress?: string;
+  interfaceIndex?: number;
+}
 
 declare interface datagram_event {
-  type: 'message' | 'error' | 'close';
-  family?: string;
-  address?: string;
-  port?: number;
+  type: 'message' | 'error' | 'close' | 'reply' | 'timeout';
+  // Set on 'reply' / 'timeout', as returned by datagram_sendRequest
+  requestId?: number;
+  rinfo?: datagram_rinfo;
   data?: ArrayBuffer;
   error?: Error;
 }
 
 declare function datagram_bind(
   id: number,
-  type: 4 | 6,
+  type: number,
   host: string,
   port: number
 ): void;
@@ -34,21 +43,142 @@ declare function datagram_getOpt(
 
 declare function datagram_send(
   id: number,
-  type: 4 | 6,
+  type: number,
   host: string,
   port: number,
-  data: ArrayBuffer
+  data: ArrayBuffer,
+  source?: { address?: string; interfaceIndex?: number; tos?: number }
 ): void;
 
+declare interface datagram_request_options {
+  tokenOffset: number;
+  tokenLength: number;
+  anySource?: boolean;
+  retries?: number;
+  timeoutMs?: number;
+  backoff?: number;
+}
+
+declare function datagram_sendRequest(
+  id: number,
+  type: number,
+  host: string,
+  port: number,
+  data: ArrayBuffer,
+  options: datagram_request_options
+): number;
+
 declare function datagram_getSockName(
   id: number,
-  type: 4 | 6
+  type: number
 ): {
-  family: 'IPv4' | 'IPv6';
+  family: 'IPv4' | 'IPv6' | 'unix';
   address: string;
   port: number;
 };
 
+declare function datagram_setPollerOptions(options: {
+  spinUs?: number;
+  busyPollUs?: number;
+  priority?: number;
+  cpus?: number[];
+  readBudget?: number;
+}): void;
+
+declare function datagram_adopt(id: number): void;
+
+declare function datagram_setSuspendMode(
+  mode: 'cold' | 'warm',
+  holdBytes: number
+): void;
+
+declare interface datagram_jitter_options {
+  seqOffset?: number;
+  seqBytes?: number;
+  timestampOffset?: number;
+  timestampBytes?: number;
+  clockRate?: number;
+  packetIntervalMs?: number;
+  playoutDelayMs?: number;
+  window?: number;
+}
+
+declare interface datagram_jitter_stats {
+  received: number;
+  released: number;
+  lost: number;
+  reordered: number;
+  late: number;
+  duplicates: number;
+}
+
+declare function datagram_setJitterBuffer(
+  id: number,
+  options: datagram_jitter_options | null
+): void;
+
+declare function datagram_getJitterStats(
+  id: number
+): datagram_jitter_stats | undefined;
+
+declare interface datagram_drop_stats {
+  drops: number;
+  supported: boolean;
+  recvBufferSize: number;
+}
+
+declare interface datagram_recv_buffer_tuning {
+  min?: number;
+  max?: number;
+  quietMs?: number;
+}
+
+declare function datagram_getDropStats(id: number): datagram_drop_stats;
+
+declare function datagram_setRecvBufferAutoTune(
+  id: number,
+  options: datagram_recv_buffer_tuning | null
+): void;
+
+declare function datagram_setPriority(
+  id: number,
+  priority: 'normal' | 'high'
+): void;
+
+declare function datagram_setDeliveryOptions(options: {
+  normalWindow?: number;
+  windowTimeoutMs?: number;
+}): void;
+
+declare interface datagram_lane_stats {
+  depth: number;
+  maxDepth: number;
+  delivered: number;
+  avgWaitUs: number;
+  maxWaitUs: number;
+}
+
+declare function datagram_getDeliveryStats(reset: boolean): {
+  high: datagram_lane_stats;
+  normal: datagram_lane_stats;
+  inFlight: number;
+};
+
+declare function datagram_startCapture(
+  path: string,
+  options: {
+    snapLen?: number;
+    bufferBytes?: number;
+  }
+): void;
+
+declare function datagram_stopCapture():
+  | { packets: number; bytes: number; dropped: number }
+  | undefined;
+
+declare function datagram_setRemoteInfoMode(mode: 'lazy' | 'eager'): void;
+
+declare var dgc_UNIX_DGRAM: number;
 declare var dgc_SOL_SOCKET: number;
 declare var dgc_IPPROTO_IP: number;
 declare var dgc_IPPROTO_IPV6: number;
@@ -62,6 +192,12 @@ declare var dgc_IP_MULTICAST_LOOP: number;
 declare var dgc_IP_ADD_MEMBERSHIP: number;
 declare var dgc_IP_DROP_MEMBERSHIP: number;
 declare var dgc_IP_TTL: number;
+declare var dgc_IP_RECVPKTINFO: number;
+declare var dgc_IPV6_RECVPKTINFO: number;
+declare var dgc_IP_TOS: number;
+declare var dgc_IP_RECVTOS: number;
+declare var dgc_IPV6_TCLASS: number;
+declare var dgc_IPV6_RECVTCLASS: number;
 declare var datagram_callbacks: {
   [key: string]: (event: datagram_event) => void;
 };